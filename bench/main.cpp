@@ -0,0 +1,195 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <unistd.h>
+
+#include "options.hpp"
+
+using namespace std;
+
+//
+// The days and the input format each one reads
+//
+enum Format { DEPTHS, COMMANDS, BITS, NUM_FORMATS };
+
+struct Day {
+  string name;
+  Format format;
+};
+
+const vector<Day> allDays = {
+  {"day1_part1", DEPTHS}, {"day1_part2", DEPTHS},
+  {"day2_part1", COMMANDS}, {"day2_part2", COMMANDS},
+  {"day3_part1", BITS}, {"day3_part2", BITS},
+};
+
+vector<string> Split(const string& list) {
+  vector<string> items;
+  stringstream in(list);
+  string item;
+  while (getline(in, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+//
+// Write numLines lines in the format of a day's input, generated like the puzzle
+// inputs: a random walk of depths, a mix of commands and 12 bit diagnostic rows.
+//
+void WriteInput(const string& path, Format format, size_t numLines) {
+  ofstream out(path);
+  mt19937 rng(2021);
+  const char* commands[] = {"forward ", "up ", "down "};
+  int depth = 200;
+  string buffer;
+
+  for (size_t line = 0; line < numLines; ++line) {
+    switch (format) {
+    case DEPTHS:
+      depth = max(0, depth + int(rng() % 21) - 8);
+      buffer += to_string(depth);
+      break;
+    case COMMANDS:
+      buffer += commands[rng() % 3];
+      buffer += char('1' + rng() % 9);
+      break;
+    case BITS:
+      for (int bit = 0; bit < 12; ++bit) {
+        buffer += rng() & 1 ? '1' : '0';
+      }
+      break;
+    default:
+      break;
+    }
+    buffer += '\n';
+
+    if (buffer.size() > (1 << 20)) {
+      out << buffer;
+      buffer.clear();
+    }
+  }
+  out << buffer;
+}
+
+string ReadFile(const string& path) {
+  ifstream in(path);
+  stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+int main(int argc, char** argv)
+{
+  Options options(argc, argv);
+
+  //
+  // What to sweep. Sizes are the number of lines of input, tiles the tiles per IPU of
+  // the IPUModel.
+  //
+  vector<string> days = Split(options.get("days", "day1_part1,day1_part2,day2_part1,day2_part2,day3_part1,day3_part2"));
+  vector<string> sizes = Split(options.get("sizes", "1000,10000,100000,1000000,10000000,100000000"));
+  vector<string> tiles = Split(options.get("tiles", "16,64,256,1216"));
+  unsigned repeats = options.getUnsigned("repeat", 20);
+  string backend = options.get("backend", "model");
+  string root = options.get("root", "..");
+  string workDir = options.get("work-dir", "/tmp");
+  string outputPath = options.get("output", "bench.json");
+  bool generate = options.has("generate");
+
+  //
+  // The accumulator widths to run day 2 with, to measure what --wide costs over the
+  // 32-bit path
+  //
+  vector<string> widths = Split(options.get("accumulate", "32"));
+
+  vector<string> results;
+  for (const auto& size : sizes) {
+    size_t numLines = stoull(size);
+
+    //
+    // Write each input format needed at this size once, shared by both parts. With
+    // --generate the days generate their input on the device instead.
+    //
+    string inputs[NUM_FORMATS];
+    for (const auto& day : allDays) {
+      if (find(days.begin(), days.end(), day.name) == days.end() || !inputs[day.format].empty()) {
+        continue;
+      }
+      if (generate) {
+        inputs[day.format] = "--generate=" + size;
+        continue;
+      }
+      inputs[day.format] = workDir + "/bench_" + to_string(::getpid()) + "_" + to_string(day.format) + "_" + size + ".txt";
+      cout << "Writing " << numLines << " lines to " << inputs[day.format] << endl;
+      WriteInput(inputs[day.format], day.format, numLines);
+    }
+
+    for (const auto& day : allDays) {
+      if (inputs[day.format].empty() || find(days.begin(), days.end(), day.name) == days.end()) {
+        continue;
+      }
+      for (const auto& tileCount : tiles) {
+        for (const auto& width : day.format == COMMANDS ? widths : vector<string>{"32"}) {
+          //
+          // Run the day in its own directory, its output goes to a log and its timings
+          // to a JSON file which is added to the results
+          //
+          string jsonPath = workDir + "/bench_" + to_string(::getpid()) + ".json";
+          string logPath = day.name + "_" + size + "_" + tileCount + "_" + width + ".log";
+          string command = "cd " + root + "/" + day.name + " && ./out"
+            + " --backend=" + backend + " --tiles=" + tileCount
+            + " " + (generate ? inputs[day.format] : "--input=" + inputs[day.format])
+            + " --repeat=" + to_string(repeats)
+            + (width == "64" ? " --wide" : "")
+            + " --json=" + jsonPath
+            + " > " + workDir + "/" + logPath + " 2>&1";
+
+          cout << day.name << " size " << size << " tiles " << tileCount << " accumulate " << width << flush;
+          remove(jsonPath.c_str());
+          int status = system(command.c_str());
+
+          string json = ReadFile(jsonPath);
+          if (status != 0 || json.empty()) {
+            cout << " failed, see " << workDir << "/" << logPath << endl;
+            results.push_back("{\n  \"name\": \"" + day.name + "\",\n  \"size\": " + size +
+                              ",\n  \"tiles\": " + tileCount + ",\n  \"accumulate\": " + width +
+                              ",\n  \"error\": \"exit status " + to_string(status) + "\"\n}\n");
+          } else {
+            cout << endl;
+            results.push_back(json);
+          }
+          remove(jsonPath.c_str());
+        }
+      }
+    }
+
+    for (const auto& input : inputs) {
+      if (!input.empty() && !generate) {
+        remove(input.c_str());
+      }
+    }
+  }
+
+  //
+  // All the runs as one JSON array
+  //
+  ofstream out(outputPath);
+  out << "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    out << (i == 0 ? "" : ",\n") << results[i];
+  }
+  out << "]\n";
+  cout << "Wrote " << results.size() << " results to " << outputPath << endl;
+
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <unistd.h>
+
+#include "options.hpp"
+#include "input.hpp"
+
+using namespace std;
+
+//
+// Write a file of roughly sizeBytes made of lines produced by makeLine
+//
+string WriteInput(size_t sizeBytes, function<string(mt19937&)> makeLine) {
+  char path[] = "/tmp/bench_parse_XXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+
+  ofstream out(path);
+  mt19937 rng(2021);
+  size_t written = 0;
+  while (written < sizeBytes) {
+    string line = makeLine(rng);
+    out << line << '\n';
+    written += line.size() + 1;
+  }
+  return path;
+}
+
+//
+// Best throughput in MB/s over a few runs. The checksum stops the compiler from
+// throwing the parsing away and lets us check both paths agree.
+//
+double Throughput(const string& path, function<long(const string&)> parse, long& checksum) {
+  ifstream file(path, ios::binary | ios::ate);
+  double megabytes = file.tellg() / 1e6;
+
+  double best = 0;
+  for (int run = 0; run < 3; ++run) {
+    auto start = chrono::steady_clock::now();
+    checksum = parse(path);
+    chrono::duration<double> seconds = chrono::steady_clock::now() - start;
+    best = max(best, megabytes / seconds.count());
+  }
+  return best;
+}
+
+void Report(const string& name, const string& path,
+            function<long(const string&)> getlinePath,
+            function<long(const string&)> mappedPath) {
+  long getlineChecksum = 0;
+  long mappedChecksum = 0;
+  double getlineRate = Throughput(path, getlinePath, getlineChecksum);
+  double mappedRate = Throughput(path, mappedPath, mappedChecksum);
+
+  cout << name << ": getline " << getlineRate << " MB/s, mmap " << mappedRate << " MB/s ("
+       << mappedRate / getlineRate << "x)" << (getlineChecksum == mappedChecksum ? "" : " CHECKSUM MISMATCH") << endl;
+}
+
+int main(int argc, char** argv)
+{
+  Options options(argc, argv);
+  size_t sizeBytes = size_t(options.getUnsigned("size-mb", 256)) * 1000 * 1000;
+
+  //
+  // Day 1 - integers
+  //
+  {
+    string path = WriteInput(sizeBytes, [](mt19937& rng) { return to_string(rng() % 10000); });
+    Report("integers", path,
+      [](const string& path) {
+        ifstream data(path);
+        string line;
+        vector<int> values;
+        while (getline(data, line)) {
+          values.push_back(atoi(line.c_str()));
+        }
+        long sum = 0;
+        for (int v : values) sum += v;
+        return sum;
+      },
+      [](const string& path) {
+        MappedFile data(path);
+        vector<int> values = ParseIntegers(data.contents());
+        long sum = 0;
+        for (int v : values) sum += v;
+        return sum;
+      });
+    remove(path.c_str());
+  }
+
+  //
+  // Day 2 - commands
+  //
+  {
+    const char* names[] = {"forward", "up", "down"};
+    string path = WriteInput(sizeBytes, [&](mt19937& rng) { return string(names[rng() % 3]) + " " + to_string(1 + rng() % 9); });
+    Report("commands", path,
+      [](const string& path) {
+        ifstream data(path);
+        string line;
+        vector<int> hValues;
+        vector<int> vValues;
+        while (getline(data, line)) {
+          auto space = line.find(" ");
+          auto command = line.substr(0, space);
+          auto value = line.substr(space + 1, line.size() - space);
+          if(command == "forward") {
+            hValues.push_back(atoi(value.c_str()));
+          } else if (command == "up") {
+            vValues.push_back(0 - atoi(value.c_str()));
+          } else if (command == "down") {
+            vValues.push_back(atoi(value.c_str()));
+          }
+        }
+        long sum = 0;
+        for (int v : hValues) sum += v;
+        for (int v : vValues) sum += 3 * v;
+        return sum;
+      },
+      [](const string& path) {
+        MappedFile data(path);
+        Commands commands = ParseCommands(data.contents());
+        long sum = 0;
+        for (size_t i = 0; i < commands.values.size(); ++i) {
+          int value = commands.values[i];
+          sum += commands.opcodes[i] == FORWARD ? value : commands.opcodes[i] == UP ? -3 * value : 3 * value;
+        }
+        return sum;
+      });
+    remove(path.c_str());
+  }
+
+  //
+  // Day 3 - binary strings
+  //
+  {
+    string path = WriteInput(sizeBytes, [](mt19937& rng) {
+      string line(12, '0');
+      for (auto& c : line) c = rng() & 1 ? '1' : '0';
+      return line;
+    });
+    Report("bits", path,
+      [](const string& path) {
+        ifstream data(path);
+        string line;
+        vector<vector<int>> values;
+        while (getline(data, line)) {
+          vector<int> r;
+          for(char c : line) {
+            r.push_back(c == '0' ? 0 : 1);
+          }
+          values.push_back(r);
+        }
+        vector<int> flattenValues;
+        for(size_t i = 0; i < values.size(); ++i) {
+          for(size_t j = 0; j < values[i].size(); ++j) {
+            flattenValues.push_back(values[i][j]);
+          }
+        }
+        long sum = 0;
+        for (size_t i = 0; i < flattenValues.size(); ++i) sum += flattenValues[i] * (i % 12);
+        return sum;
+      },
+      [](const string& path) {
+        MappedFile data(path);
+        BitMatrix matrix = ParseBitMatrix(data.contents());
+        long sum = 0;
+        for (size_t i = 0; i < matrix.bits.size(); ++i) sum += matrix.bits[i] * (i % 12);
+        return sum;
+      });
+    remove(path.c_str());
+  }
+
+  return 0;
+}
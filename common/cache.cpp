@@ -0,0 +1,167 @@
+#include <cache.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <poplar/VersionInfo.hpp>
+
+using namespace poplar;
+namespace fs = std::filesystem;
+
+namespace {
+
+//
+// FNV-1a, we want a hash which is stable between runs and builds which std::hash
+// does not promise
+//
+std::uint64_t Fnv1a(const std::string& s) {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+fs::path CacheDirectory() {
+  const char* dir = std::getenv("AOC_CACHE_DIR");
+  return dir ? fs::path(dir) : fs::path("..") / "cache";
+}
+
+//
+// Identify the binary doing the compile, so an executable built by older code is
+// never picked up after a rebuild.
+//
+std::string BinaryIdentity() {
+  std::error_code ec;
+  auto time = fs::last_write_time("/proc/self/exe", ec);
+  auto size = fs::file_size("/proc/self/exe", ec);
+  if (ec) {
+    return "unknown";
+  }
+  return std::to_string(time.time_since_epoch().count()) + ":" + std::to_string(size);
+}
+
+std::string CacheKey(const Graph& graph, const std::string& name,
+                     const std::vector<std::size_t>& shape, const OptionFlags& options) {
+  const Target& target = graph.getTarget();
+
+  std::ostringstream key;
+  key << name << ";shape=";
+  for (auto dim : shape) {
+    key << dim << ",";
+  }
+  key << ";options=";
+  for (const auto& option : options) {
+    key << option.first << "=" << option.second << ",";
+  }
+  key << ";target=" << static_cast<int>(target.getTargetType())
+      << "," << target.getNumIPUs()
+      << "," << target.getTilesPerIPU()
+      << "," << target.getTargetArchString()
+      << ";poplar=" << poplar::packageHash()
+      << ";binary=" << BinaryIdentity();
+
+  std::ostringstream hash;
+  hash << name << "-" << std::hex << std::setw(16) << std::setfill('0') << Fnv1a(key.str());
+  return hash.str();
+}
+
+//
+// Profiled compiles write the graph profile that the execution profile is added to
+// (see profile.hpp), so they are never cached
+//
+bool IsProfiling(const OptionFlags& options) {
+  for (const auto& option : options) {
+    if (option.first.rfind("autoReport.", 0) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+Executable CompileOrLoad(Graph& graph,
+                         const std::vector<program::Program>& programs,
+                         const std::string& name,
+                         const std::vector<std::size_t>& shape,
+                         const OptionFlags& options) {
+  auto start = std::chrono::steady_clock::now();
+  if (IsProfiling(options)) {
+    Executable executable = compileGraph(graph, programs, options);
+    std::cout << "Compiled graph for profiling (" << MillisecondsSince(start) << " ms)\n";
+    return executable;
+  }
+
+  fs::path path = CacheDirectory() / (CacheKey(graph, name, shape, options) + ".poplar_exec");
+
+  //
+  // Warm start, deserialize the executable we compiled on a previous run
+  //
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (in) {
+      try {
+        Executable executable = Executable::deserialize(in);
+        std::cout << "Loaded cached executable " << path.filename().string()
+                  << " (warm start " << MillisecondsSince(start) << " ms)\n";
+        return executable;
+      } catch (const std::exception& e) {
+        std::cerr << "Ignoring unreadable cached executable " << path << ": " << e.what() << "\n";
+      }
+    }
+  }
+
+  //
+  // Cold start, compile and store the executable. Write to a temporary file first
+  // so another process never sees a half written executable.
+  //
+  Executable executable = compileGraph(graph, programs, options);
+  double compileTime = MillisecondsSince(start);
+
+  std::error_code ec;
+  fs::create_directories(path.parent_path(), ec);
+  fs::path tmpPath = path;
+  tmpPath += ".tmp" + std::to_string(::getpid());
+
+  //
+  // Only a complete, flushed executable is renamed into place. Failing to cache is
+  // not an error, the executable just has to be compiled again next time.
+  //
+  std::string error;
+  try {
+    std::ofstream out(tmpPath, std::ios::binary);
+    if (out) {
+      executable.serialize(out);
+      out.close();
+    }
+    if (!out) {
+      error = "could not write " + tmpPath.string();
+    }
+  } catch (const std::exception& e) {
+    error = e.what();
+  }
+  if (error.empty()) {
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+      error = ec.message();
+    }
+  }
+  if (!error.empty()) {
+    std::cerr << "Could not cache executable at " << path << ": " << error << "\n";
+    fs::remove(tmpPath, ec);
+  }
+
+  std::cout << "Compiled graph (cold start " << compileTime << " ms)\n";
+  return executable;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <poplar/Engine.hpp>
+#include <poplar/Executable.hpp>
+#include <poplar/Graph.hpp>
+#include <poplar/OptionFlags.hpp>
+#include <poplar/Program.hpp>
+
+//
+// Compile the programs for the graph, or load a previously compiled executable
+// from the on-disk cache.
+//
+// The cache key is a hash of the name, the shape of the input, the compile options,
+// the target and the binary doing the compile. So changing the input size or
+// rebuilding the code will compile a new executable rather than reuse a stale one.
+//
+// The cache lives in the directory given by the AOC_CACHE_DIR environment variable,
+// or ../cache (i.e. the root of the repo when run from a day's directory).
+//
+// Compiles with profiling turned on (see profile.hpp) always compile and are not
+// cached, as the compile writes the graph profile.
+//
+poplar::Executable CompileOrLoad(poplar::Graph& graph,
+                                 const std::vector<poplar::program::Program>& programs,
+                                 const std::string& name,
+                                 const std::vector<std::size_t>& shape,
+                                 const poplar::OptionFlags& options = {});
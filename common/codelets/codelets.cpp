@@ -0,0 +1,307 @@
+#include <poplar/Vertex.hpp>
+
+using namespace poplar;
+
+//
+// Count how many of the values are greater than the value before them. The first
+// value is compared with previous, which is the last value of the region before
+// this one (or the first value itself at the very start, which is never counted).
+//
+// One pass over the values, replacing a subtract, compare, cast and reduce each with
+// their own full length intermediate tensor.
+//
+// T is the type of the values, narrowed to the range of the input (see types.hpp). The
+// count is always 32 bits.
+//
+template <typename T>
+class CountIncreases : public Vertex {
+public:
+  Input<Vector<T>> values;
+  Input<T> previous;
+  Output<int> count;
+
+  bool compute() {
+    const T* __restrict in = &values[0];
+    const unsigned n = values.size();
+
+    //
+    // Compare each value with the one before it, the comparisons are independent so
+    // the loop can be unrolled and pipelined
+    //
+    int total = n > 0 && in[0] > *previous;
+    #pragma unroll 4
+    for (unsigned i = 1; i < n; ++i) {
+      total += in[i] > in[i - 1];
+    }
+    *count = total;
+    return true;
+  }
+};
+
+template class CountIncreases<unsigned char>;
+template class CountIncreases<short>;
+template class CountIncreases<int>;
+
+//
+// Count how many of a are greater than the corresponding element of b
+//
+template <typename T>
+class CountGreater : public Vertex {
+public:
+  Input<Vector<T>> a;
+  Input<Vector<T>> b;
+  Output<int> count;
+
+  bool compute() {
+    const T* __restrict x = &a[0];
+    const T* __restrict y = &b[0];
+    const unsigned n = a.size();
+
+    int total = 0;
+    #pragma unroll 4
+    for (unsigned i = 0; i < n; ++i) {
+      total += x[i] > y[i];
+    }
+    *count = total;
+    return true;
+  }
+};
+
+template class CountGreater<unsigned char>;
+template class CountGreater<short>;
+template class CountGreater<int>;
+
+//
+// Decode packed (value << 2 | opcode) command records and sum the values for each
+// opcode, sums[opcode] is the total for that opcode. The records are narrowed to the
+// range of the input, the sums are 32 bits.
+//
+template <typename T>
+class SumByOpcode : public Vertex {
+public:
+  Input<Vector<T>> records;
+  Output<Vector<int>> sums;
+
+  bool compute() {
+    int totals[4] = {0, 0, 0, 0};
+    for (unsigned i = 0; i < records.size(); ++i) {
+      int record = records[i];
+      totals[record & 3] += unsigned(record) >> 2;
+    }
+    for (unsigned op = 0; op < sums.size(); ++op) {
+      sums[op] = totals[op];
+    }
+    return true;
+  }
+};
+
+template class SumByOpcode<unsigned char>;
+template class SumByOpcode<short>;
+template class SumByOpcode<int>;
+
+//
+// As SumByOpcode for --wide, with the sums of this region in 64 bits (emulated by the
+// compiler) so a long region of large values can't overflow. sums has the {lo, hi}
+// words of each opcode's total, to be combined by SumWidePairs.
+//
+template <typename T>
+class SumByOpcodeWide : public Vertex {
+public:
+  Input<Vector<T>> records;
+  Output<Vector<unsigned>> sums;
+
+  bool compute() {
+    long long totals[4] = {0, 0, 0, 0};
+    for (unsigned i = 0; i < records.size(); ++i) {
+      int record = records[i];
+      totals[record & 3] += unsigned(record) >> 2;
+    }
+    for (unsigned op = 0; op < sums.size() / 2; ++op) {
+      sums[2 * op] = unsigned(totals[op]);
+      sums[2 * op + 1] = unsigned((unsigned long long)totals[op] >> 32);
+    }
+    return true;
+  }
+};
+
+template class SumByOpcodeWide<unsigned char>;
+template class SumByOpcodeWide<short>;
+template class SumByOpcodeWide<int>;
+
+//
+// For day 2 part 2 with --wide. The sum of value * aim over the forward records of this
+// region in 64 bits (emulated by the compiler), written as {lo, hi} to be combined by
+// SumWidePairs. aim is the aim at each record.
+//
+template <typename T>
+class AimedDepthWide : public Vertex {
+public:
+  Input<Vector<T>> records;
+  Input<Vector<int>> aim;
+  Output<Vector<unsigned>> depth;
+
+  bool compute() {
+    long long total = 0;
+    for (unsigned i = 0; i < records.size(); ++i) {
+      int record = records[i];
+      if ((record & 3) == 0) {
+        total += (long long)(unsigned(record) >> 2) * aim[i];
+      }
+    }
+    depth[0] = unsigned(total);
+    depth[1] = unsigned((unsigned long long)total >> 32);
+    return true;
+  }
+};
+
+template class AimedDepthWide<unsigned char>;
+template class AimedDepthWide<short>;
+template class AimedDepthWide<int>;
+
+//
+// Add the value to the 64-bit {lo, hi} sum, for a running total kept over the
+// iterations of a loop
+//
+class AccumulateWide : public Vertex {
+public:
+  Input<int> value;
+  InOut<Vector<unsigned>> sum;
+
+  bool compute() {
+    unsigned long long total = ((unsigned long long)sum[1] << 32) | sum[0];
+    total += (long long)*value;
+    sum[0] = unsigned(total);
+    sum[1] = unsigned(total >> 32);
+    return true;
+  }
+};
+
+//
+// Sum 64-bit {lo, hi} pairs, written as {lo, hi}
+//
+class SumWidePairs : public Vertex {
+public:
+  Input<Vector<unsigned>> pairs;
+  Output<Vector<unsigned>> sum;
+
+  bool compute() {
+    unsigned long long total = 0;
+    for (unsigned i = 0; i + 1 < pairs.size(); i += 2) {
+      total += ((unsigned long long)pairs[i + 1] << 32) | pairs[i];
+    }
+    sum[0] = unsigned(total);
+    sum[1] = unsigned(total >> 32);
+    return true;
+  }
+};
+
+//
+// Prefix sum of the values in this region. Inclusive gives out[i] = in[0] + ... + in[i],
+// exclusive gives out[i] = in[0] + ... + in[i - 1]. The total of the region is written to
+// total so the regions can be joined up by ScanCarries and ScanAddCarry.
+//
+template <bool Exclusive>
+class ScanRegion : public Vertex {
+public:
+  Input<Vector<int>> in;
+  Output<Vector<int>> out;
+  Output<int> total;
+
+  bool compute() {
+    int sum = 0;
+    for (unsigned i = 0; i < in.size(); ++i) {
+      int value = in[i];
+      if (Exclusive) {
+        out[i] = sum;
+        sum += value;
+      } else {
+        sum += value;
+        out[i] = sum;
+      }
+    }
+    *total = sum;
+    return true;
+  }
+};
+
+template class ScanRegion<false>;
+template class ScanRegion<true>;
+
+//
+// Exclusive prefix sum of the region totals, giving the carry into each region
+//
+class ScanCarries : public Vertex {
+public:
+  Input<Vector<int>> totals;
+  Output<Vector<int>> carries;
+
+  bool compute() {
+    int sum = 0;
+    for (unsigned i = 0; i < totals.size(); ++i) {
+      carries[i] = sum;
+      sum += totals[i];
+    }
+    return true;
+  }
+};
+
+//
+// Add the carry from the regions before to every element of this region
+//
+class ScanAddCarry : public Vertex {
+public:
+  InOut<Vector<int>> data;
+  Input<int> carry;
+
+  bool compute() {
+    const int c = *carry;
+    for (unsigned i = 0; i < data.size(); ++i) {
+      data[i] += c;
+    }
+    return true;
+  }
+};
+
+//
+// Count the 1s in each bit position of the packed words. counts[0] is the most
+// significant of the counts.size() bits (the first character of the line) and
+// counts[counts.size() - 1] the least significant.
+//
+// Bits is the width of the rows for the widths with their own instantiation (see
+// specialisedWidths in input.hpp), so the loops over the bits are fully unrolled with
+// constant shifts and masks. It is 0 for any other width, taken from counts.size().
+// T is the narrowest unsigned type with the bits of a row (see types.hpp), or unsigned.
+//
+template <unsigned Bits, typename T>
+class CountBits : public Vertex {
+public:
+  Input<Vector<T>> words;
+  Output<Vector<unsigned>> counts;
+
+  bool compute() {
+    const unsigned numBits = Bits ? Bits : counts.size();
+    unsigned totals[32] = {0};
+    for (unsigned i = 0; i < words.size(); ++i) {
+      const unsigned word = words[i];
+      #pragma unroll
+      for (unsigned bit = 0; bit < numBits; ++bit) {
+        totals[bit] += (word >> bit) & 1;
+      }
+    }
+    for (unsigned bit = 0; bit < numBits; ++bit) {
+      counts[numBits - 1 - bit] = totals[bit];
+    }
+    return true;
+  }
+};
+
+template class CountBits<0, unsigned char>;
+template class CountBits<0, unsigned short>;
+template class CountBits<0, unsigned>;
+template class CountBits<8, unsigned char>;
+template class CountBits<8, unsigned>;
+template class CountBits<12, unsigned short>;
+template class CountBits<12, unsigned>;
+template class CountBits<16, unsigned short>;
+template class CountBits<16, unsigned>;
+template class CountBits<32, unsigned>;
@@ -1,33 +1,106 @@
 #include <common.hpp>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
 #include <poplar/IPUModel.hpp>
+#include <popops/codelets.hpp>
+#include <poprand/codelets.hpp>
 
 using namespace poplar;
 
-bool useIpuModel = false;
-
-poplar::Device GetIPUDevice() {
-  
-  if(useIpuModel) {
-      std::cout << "Creating an IPU Model\n";
-    IPUModel ipuModel;
-    Device device = ipuModel.createDevice();
-    return device;
-  } else {
-    auto manager = DeviceManager::createDeviceManager();
-    auto devices = manager.getDevices(poplar::TargetType::IPU, 1);
-    std::cout << "Trying to attach to IPU\n";
-    auto it = std::find_if(devices.begin(), devices.end(), [](Device &device) {
-        return device.attach();
-    });
-
-    if (it == devices.end()) {
-        std::cerr << "Error attaching to device\n";
-        exit(-1);
-    }
-
-    Device device = std::move(*it);
-    std::cout << "Attached to IPU " << device.getId() << std::endl;
-    return device;
+namespace {
+
+std::optional<Device> AttachToIPU(unsigned numIPUs) {
+  auto manager = DeviceManager::createDeviceManager();
+  auto devices = manager.getDevices(poplar::TargetType::IPU, numIPUs);
+  std::cout << "Trying to attach to IPU\n";
+  auto it = std::find_if(devices.begin(), devices.end(), [](Device &device) {
+      return device.attach();
+  });
+
+  if (it == devices.end()) {
+    return std::nullopt;
+  }
+
+  std::cout << "Attached to IPU " << it->getId() << std::endl;
+  return std::move(*it);
+}
+
+Device CreateIPUModel(const Options& options) {
+  IPUModel ipuModel;
+  ipuModel.numIPUs = options.getUnsigned("ipus", ipuModel.numIPUs);
+  ipuModel.tilesPerIPU = options.getUnsigned("tiles", ipuModel.tilesPerIPU);
+  std::cout << "Creating an IPU Model with " << ipuModel.numIPUs << " IPU(s) of "
+            << ipuModel.tilesPerIPU << " tiles\n";
+  return ipuModel.createDevice();
+}
+
+Device SelectDevice(const Options& options, std::string& backend) {
+  if (backend == "cpu") {
+    std::cout << "Creating a CPU device\n";
+    return Device::createCPUDevice();
+  }
+
+  if (backend == "model") {
+    return CreateIPUModel(options);
+  }
+
+  if (backend != "ipu" && backend != "auto") {
+    throw DeviceError("Unknown backend '" + backend + "', expected ipu, model, cpu, host or auto");
+  }
+
+  auto device = AttachToIPU(options.getUnsigned("ipus", 1));
+  if (device) {
+    backend = "ipu";
+    return std::move(*device);
+  }
+
+  //
+  // Only fall back when the hardware was not explicitly asked for
+  //
+  if (backend == "ipu") {
+    throw DeviceError("Error attaching to device");
+  }
+  std::cerr << "No IPU available, falling back to the IPU Model\n";
+  backend = "model";
+  return CreateIPUModel(options);
+}
+
+//
+// Create the device for the backend and report how long it took, so startup can
+// be compared across the backends
+//
+Device CreateDevice(const Options& options, std::string& backend) {
+  auto start = std::chrono::steady_clock::now();
+  Device device = SelectDevice(options, backend);
+  std::cout << "Using the " << backend << " backend (device ready in "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+            << " ms)\n";
+  return device;
+}
+
+} // namespace
+
+IpuSession::IpuSession(const Options& options)
+    : backend_(options.get("backend", "auto")),
+      device_(CreateDevice(options, backend_)),
+      target_(device_.getTarget()),
+      graph_(createGraph()) {
+}
+
+Graph IpuSession::createGraph() const {
+  Graph graph(target_);
+  popops::addCodelets(graph);
+  poprand::addCodelets(graph);
+  return graph;
+}
+
+int RunMain(int argc, char** argv, int (*run)(int argc, char** argv)) {
+  try {
+    return run(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
   }
-}
\ No newline at end of file
+}
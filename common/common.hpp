@@ -1,4 +1,57 @@
+#pragma once
 
+#include <stdexcept>
+#include <string>
 #include <poplar/DeviceManager.hpp>
+#include <poplar/Graph.hpp>
+#include <poplar/Target.hpp>
 
-poplar::Device GetIPUDevice();
\ No newline at end of file
+#include <options.hpp>
+
+//
+// Owns the device, target and graph (with the popops and poprand codelets added) for a run.
+//
+// The backend is chosen with --backend (or AOC_BACKEND):
+//   ipu   - attach to IPU hardware
+//   model - an IPUModel, the size can be set with --tiles and --ipus
+//   cpu   - the Poplar CPU target, runs on any Linux box
+//   auto  - (the default) try the hardware and fall back to the IPUModel if no
+//           IPU can be attached
+//
+//
+// Creating the session throws a DeviceError for an unknown --backend, or when the
+// hardware asked for with --backend=ipu can't be attached.
+//
+class DeviceError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+class IpuSession {
+public:
+  explicit IpuSession(const Options& options);
+
+  poplar::Device& getDevice() { return device_; }
+  const poplar::Target& getTarget() const { return target_; }
+  poplar::Graph& getGraph() { return graph_; }
+  const std::string& getBackend() const { return backend_; }
+
+  //
+  // A new graph for the target with the codelets added, for when more than one
+  // executable is compiled for the device
+  //
+  poplar::Graph createGraph() const;
+
+private:
+  std::string backend_;
+  poplar::Device device_;
+  poplar::Target target_;
+  poplar::Graph graph_;
+};
+
+//
+// Run a day's main, turning an exception that escapes it into an error message and an
+// exit status of 1. The stack is unwound on the way out, so the device is detached
+// rather than left to the exit.
+//
+int RunMain(int argc, char** argv, int (*run)(int argc, char** argv));
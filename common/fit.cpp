@@ -0,0 +1,103 @@
+#include <fit.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include <mapping.hpp>
+
+using namespace poplar;
+
+namespace {
+
+//
+// The part of each tile held back for the code, vertex state, stacks and exchange
+// buffers
+//
+const double reservedFraction = 0.2;
+
+std::string Kilobytes(std::size_t bytes) {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1) << bytes / 1024.0 << " KB";
+  return out.str();
+}
+
+} // namespace
+
+MemoryPlan::MemoryPlan(const Target& target, const std::string& name)
+  : target_(target), name_(name), tileMemory_(target.getBytesPerTile()),
+    reserved_(static_cast<std::size_t>(tileMemory_ * reservedFraction)) {}
+
+void MemoryPlan::addTensor(const std::string& name, std::size_t numElements, const Type& type, unsigned numTiles) {
+  addTemporary("", name, numElements, type, numTiles);
+}
+
+void MemoryPlan::addTemporary(const std::string& phase, const std::string& name, std::size_t numElements,
+                              const Type& type, unsigned numTiles) {
+  if (numTiles == 0) {
+    numTiles = target_.getNumTiles();
+  }
+  std::size_t elements = BalancedElementsPerTile(target_, numElements, type, numTiles);
+  entries_.push_back({phase, name, type.toString(), elements * target_.getTypeSize(type)});
+}
+
+void MemoryPlan::addPerTile(const std::string& phase, const std::string& name, std::size_t numElements,
+                            const Type& type) {
+  entries_.push_back({phase, name, type.toString(), numElements * target_.getTypeSize(type)});
+}
+
+std::size_t MemoryPlan::bytesPerTile() const {
+  std::size_t live = 0;
+  std::map<std::string, std::size_t> phases;
+  for (const auto& entry : entries_) {
+    if (entry.phase.empty()) {
+      live += entry.bytes;
+    } else {
+      phases[entry.phase] += entry.bytes;
+    }
+  }
+  std::size_t peak = 0;
+  for (const auto& [phase, bytes] : phases) {
+    peak = std::max(peak, bytes);
+  }
+  return reserved_ + live + peak;
+}
+
+std::string MemoryPlan::summary() const {
+  return name_ + " needs about " + Kilobytes(bytesPerTile()) + " of the " + Kilobytes(tileMemory_) +
+         " on each tile";
+}
+
+void MemoryPlan::report(std::ostream& out) const {
+  out << summary() << ":\n";
+  for (const auto& entry : entries_) {
+    out << "  " << std::left << std::setw(24) << entry.name << std::setw(16) << entry.type
+        << std::right << std::setw(12) << Kilobytes(entry.bytes)
+        << (entry.phase.empty() ? "" : "  during " + entry.phase) << "\n";
+  }
+  out << "  " << std::left << std::setw(40) << "held back" << std::right << std::setw(12) << Kilobytes(reserved_)
+      << "  code, vertex state, stacks and exchange\n";
+}
+
+bool Fits(const Options& options, const MemoryPlan& plan) {
+  return options.get("fit") == "off" || plan.fits();
+}
+
+bool CheckFit(const Options& options, PhaseTimer& timer, const MemoryPlan& plan) {
+  timer.setParameter("estimated_bytes_per_tile", plan.bytesPerTile());
+  std::cout << plan.summary() << std::endl;
+  if (Fits(options, plan)) {
+    return true;
+  }
+  plan.report(std::cerr);
+  std::cerr << "The graph will not fit on the device (--fit=off skips this check)\n";
+  return false;
+}
+
+void RequireFit(const Options& options, const MemoryPlan& plan) {
+  if (!Fits(options, plan)) {
+    throw std::runtime_error(plan.summary());
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <poplar/Target.hpp>
+#include <poplar/Type.hpp>
+
+#include <options.hpp>
+#include <phases.hpp>
+
+//
+// Tile memory estimates, made before the graph is built and compiled.
+//
+// A graph that does not fit only fails at the end of its compile, which for a large
+// input takes minutes. So each day first describes the tensors it will create in a
+// MemoryPlan, from the size and type of its input and how each tensor is mapped, and
+// the plan is checked against the memory of a tile in a few microseconds. A day that
+// does not fit refuses straight away with a report of where the memory goes, or for
+// day 1 part 1 streams its input a chunk at a time instead.
+//
+// The estimate is for the fullest tile. It adds up the tensors that are live for the
+// whole run and the temporaries of the phase that needs the most. A part of each tile
+// is held back for the code, vertex state, stacks and exchange buffers, as they are
+// only known once compiled. --fit=off skips the check.
+//
+class MemoryPlan {
+public:
+  MemoryPlan(const poplar::Target& target, const std::string& name);
+
+  //
+  // A tensor live for the whole run, of numElements of type spread evenly over
+  // numTiles tiles (all of them by default) as MapTensorBalanced maps it
+  //
+  void addTensor(const std::string& name, std::size_t numElements, const poplar::Type& type, unsigned numTiles = 0);
+
+  //
+  // A temporary only live during one phase of the run, e.g. the intermediates of
+  // generating the input or of the algorithm
+  //
+  void addTemporary(const std::string& phase, const std::string& name, std::size_t numElements,
+                    const poplar::Type& type, unsigned numTiles = 0);
+
+  //
+  // A temporary of numElements of type on every tile used, e.g. the partial results of
+  // the workers of each tile
+  //
+  void addPerTile(const std::string& phase, const std::string& name, std::size_t numElements,
+                  const poplar::Type& type);
+
+  //
+  // The estimated bytes used on the fullest tile, including what is held back
+  //
+  std::size_t bytesPerTile() const;
+  std::size_t tileMemory() const { return tileMemory_; }
+  bool fits() const { return bytesPerTile() <= tileMemory_; }
+
+  //
+  // One line with the estimate and the tile memory, and the report of each tensor
+  //
+  std::string summary() const;
+  void report(std::ostream& out) const;
+
+private:
+  struct Entry {
+    std::string phase; // empty for the tensors live for the whole run
+    std::string name;
+    std::string type;
+    std::size_t bytes;
+  };
+
+  poplar::Target target_;
+  std::string name_;
+  std::size_t tileMemory_;
+  std::size_t reserved_;
+  std::vector<Entry> entries_;
+};
+
+//
+// True if the plan fits, or the check is off with --fit=off
+//
+bool Fits(const Options& options, const MemoryPlan& plan);
+
+//
+// Fits, printing the estimate (and recording it with the timings) and the report of
+// the plan when it does not fit
+//
+bool CheckFit(const Options& options, PhaseTimer& timer, const MemoryPlan& plan);
+
+//
+// Throws std::runtime_error with the summary if the plan does not fit, for a server
+// job with an input too large for the device
+//
+void RequireFit(const Options& options, const MemoryPlan& plan);
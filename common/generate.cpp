@@ -0,0 +1,96 @@
+#include <generate.hpp>
+#include <stdexcept>
+#include <popops/ElementWise.hpp>
+#include <popops/Cast.hpp>
+#include <poprand/RandomGen.hpp>
+
+#include <input.hpp>
+#include <scan.hpp>
+
+using namespace poplar;
+using namespace poplar::program;
+
+namespace {
+
+//
+// poprand takes the seed as a tensor of two unsigned ints, each draw below uses its
+// own seed modifier so they are independent. The seed is copied in from the host at
+// the start of prog, so it is not part of the compiled executable.
+//
+Tensor SeedTensor(Graph& graph, Sequence& prog, const std::string& debugName) {
+  Tensor t = graph.addVariable(UNSIGNED_INT, {2}, debugName + "/Seed");
+  graph.setTileMapping(t, 0);
+  auto stream = graph.addHostToDeviceFIFO("seed", UNSIGNED_INT, 2);
+  prog.add(Copy(stream, t));
+  return t;
+}
+
+//
+// Uniform integers in [minVal, maxVal], mapped like reference
+//
+Tensor UniformInt(Graph& graph, const Tensor& seed, unsigned seedModifier, const Tensor& reference,
+                  int minVal, int maxVal, Sequence& prog, const std::string& debugName) {
+  return poprand::uniform(graph, &seed, seedModifier, reference, INT, minVal, maxVal, prog, debugName);
+}
+
+} // namespace
+
+void GenerateDepths(Graph& graph, const Tensor& depths,
+                    Sequence& prog, const std::string& debugName) {
+  Tensor seedTensor = SeedTensor(graph, prog, debugName);
+
+  //
+  // Random steps, mostly down, and the depths are the running sum of the steps from a
+  // starting depth of 200
+  //
+  Tensor steps = UniformInt(graph, seedTensor, 0, depths, -8, 12, prog, debugName + "/Steps");
+  Tensor walk = PrefixSum(graph, steps, ScanType::Inclusive, prog, debugName + "/Walk");
+  popops::mapInPlace(graph, popops::expr::Add(popops::expr::_2, popops::expr::Const(200)),
+                     {depths, walk}, prog, debugName + "/Depths");
+}
+
+void GenerateCommands(Graph& graph, const Tensor& records,
+                      Sequence& prog, const std::string& debugName) {
+  Tensor seedTensor = SeedTensor(graph, prog, debugName);
+
+  Tensor opcodes = UniformInt(graph, seedTensor, 0, records, FORWARD, DOWN, prog, debugName + "/Opcodes");
+  Tensor values = UniformInt(graph, seedTensor, 1, records, 1, 9, prog, debugName + "/Values");
+
+  // records = value << 2 | opcode, as PackCommand does on the host
+  popops::mapInPlace(graph,
+                     popops::expr::BitwiseOr(popops::expr::Shl(popops::expr::_3, popops::expr::Const(2)), popops::expr::_2),
+                     {records, opcodes, values}, prog, debugName + "/Pack");
+}
+
+void GenerateBits(Graph& graph, const Tensor& words, unsigned numCols,
+                  Sequence& prog, const std::string& debugName) {
+  if (numCols == 0 || numCols > 32) {
+    throw std::invalid_argument("Can only generate rows of 1 to 32 bits, not " + std::to_string(numCols));
+  }
+  Tensor seedTensor = SeedTensor(graph, prog, debugName);
+
+  //
+  // poprand makes ints, so each word is made from two random 16 bit halves and then
+  // masked to numCols bits
+  //
+  Tensor high = UniformInt(graph, seedTensor, 0, words, 0, 0xffff, prog, debugName + "/High");
+  Tensor low = UniformInt(graph, seedTensor, 1, words, 0, 0xffff, prog, debugName + "/Low");
+  Tensor highBits = popops::cast(graph, high, UNSIGNED_INT, prog, debugName + "/CastHigh");
+  Tensor lowBits = popops::cast(graph, low, UNSIGNED_INT, prog, debugName + "/CastLow");
+
+  unsigned mask = numCols >= 32 ? 0xffffffffU : (1U << numCols) - 1;
+  popops::mapInPlace(graph,
+                     popops::expr::BitwiseAnd(popops::expr::BitwiseOr(popops::expr::Shl(popops::expr::_2, popops::expr::Const(16U)),
+                                                                      popops::expr::_3),
+                                              popops::expr::Const(mask)),
+                     {words, highBits, lowBits}, prog, debugName + "/Words");
+}
+
+void ConnectSeed(Engine& engine, const Options& options) {
+  unsigned seed = options.getUnsigned("seed", 2021);
+  engine.connectStreamToCallback("seed", [seed](void* p) {
+    unsigned* words = static_cast<unsigned*>(p);
+    words[0] = seed;
+    words[1] = 0;
+  });
+}
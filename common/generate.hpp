@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <poplar/Engine.hpp>
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+#include <poplar/Tensor.hpp>
+
+#include <options.hpp>
+
+//
+// Synthetic inputs generated on the device with poprand, written into the tensor
+// the input would otherwise be copied to. This takes parsing and the host-to-device
+// copy out of the measurements, and allows sizes that would be a pain to store.
+//
+// The inputs look like the puzzle inputs:
+//   depths   - a random walk, each step uniform in [-8, 12]
+//   commands - packed (value << 2 | opcode) records, an even mix of the opcodes with
+//              values uniform in [1, 9]
+//   bits     - rows of numCols uniform random bits
+//
+// The same seed always gives the same input. The seed is streamed in from the host by
+// prog on the "seed" stream, which ConnectSeed connects to --seed, so one executable
+// generates the input for every seed. Only one of these can be used in a graph.
+// Depths need the common codelets (AddCommonCodelets).
+//
+void GenerateDepths(poplar::Graph& graph, const poplar::Tensor& depths,
+                    poplar::program::Sequence& prog, const std::string& debugName);
+
+void GenerateCommands(poplar::Graph& graph, const poplar::Tensor& records,
+                      poplar::program::Sequence& prog, const std::string& debugName);
+
+void GenerateBits(poplar::Graph& graph, const poplar::Tensor& words, unsigned numCols,
+                  poplar::program::Sequence& prog, const std::string& debugName);
+
+//
+// Connect the "seed" stream to --seed (default 2021)
+//
+void ConnectSeed(poplar::Engine& engine, const Options& options);
@@ -0,0 +1,274 @@
+#include <host.hpp>
+#include <wide.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+bool Supports(const std::string& isa) {
+  __builtin_cpu_init();
+  if (isa == "avx512") {
+    return __builtin_cpu_supports("avx512f");
+  }
+  if (isa == "avx2") {
+    return __builtin_cpu_supports("avx2");
+  }
+  return isa == "scalar";
+}
+
+std::string BestIsa() {
+  for (const char* isa : {"avx512", "avx2"}) {
+    if (Supports(isa)) {
+      return isa;
+    }
+  }
+  return "scalar";
+}
+
+const HostKernels& KernelsFor(const std::string& isa) {
+  if (isa == "avx512") {
+    return Avx512Kernels();
+  }
+  if (isa == "avx2") {
+    return Avx2Kernels();
+  }
+  return ScalarKernels();
+}
+
+//
+// The rating search of day 3 part 2, the same as on the device. The rows matching the
+// prefix chosen so far are a range of the sorted rows, split by the first row with a
+// 1 in the next bit.
+//
+unsigned FindRating(const std::vector<unsigned>& sorted, unsigned numCols, bool mostCommon) {
+  auto lo = sorted.begin();
+  auto hi = sorted.end();
+  unsigned prefix = 0;
+  for (unsigned shift = numCols; shift-- > 0;) {
+    unsigned threshold = (prefix * 2 + 1) << shift;
+    auto split = std::lower_bound(lo, hi, threshold);
+    auto matches = hi - lo;
+    auto ones = hi - split;
+
+    bool keep;
+    if (mostCommon) {
+      keep = ones * 2 >= matches;
+    } else {
+      keep = ones == 0 ? false : ones == matches ? true : ones * 2 < matches;
+    }
+
+    if (keep) {
+      lo = split;
+    } else {
+      hi = split;
+    }
+    prefix = prefix * 2 + keep;
+  }
+  return prefix;
+}
+
+} // namespace
+
+HostEngine::HostEngine(const Options& options)
+  : isa_(options.get("isa", BestIsa())),
+    pool_(std::make_unique<ThreadPool>(std::max(1U, options.getUnsigned("threads", std::thread::hardware_concurrency())))) {
+  if (isa_ != "avx512" && isa_ != "avx2" && isa_ != "scalar") {
+    throw std::invalid_argument("Unknown --isa '" + isa_ + "', expected avx512, avx2 or scalar");
+  }
+  if (!Supports(isa_)) {
+    throw std::invalid_argument("This CPU does not support " + isa_);
+  }
+  kernels_ = &KernelsFor(isa_);
+}
+
+//
+// Split n elements into a chunk per thread, but no smaller than minChunkSize so
+// small inputs are not spread so thinly the threads cost more than they save
+//
+std::vector<HostEngine::Chunk> HostEngine::split(std::size_t n) const {
+  constexpr std::size_t minChunkSize = 1 << 16;
+  std::size_t numChunks = std::max<std::size_t>(1, std::min<std::size_t>(pool_->size(), n / minChunkSize));
+
+  std::vector<Chunk> chunks(numChunks);
+  for (std::size_t i = 0; i < numChunks; ++i) {
+    chunks[i] = {n * i / numChunks, n * (i + 1) / numChunks};
+  }
+  return chunks;
+}
+
+int HostEngine::countIncreases(const std::vector<int>& values) const {
+  auto chunks = split(values.size());
+  std::vector<int> counts(chunks.size(), 0);
+  pool_->run(chunks.size(), [&](std::size_t i) {
+    auto [begin, end] = chunks[i];
+    if (begin == end) {
+      return;
+    }
+    // As on the device the first measurement is compared with itself
+    int previous = begin == 0 ? values[0] : values[begin - 1];
+    counts[i] = kernels_->countIncreases(values.data() + begin, end - begin, previous);
+  });
+  return std::accumulate(counts.begin(), counts.end(), 0);
+}
+
+int HostEngine::countWindowIncreases(const std::vector<int>& values, std::size_t windowSize) const {
+  if (windowSize >= values.size()) {
+    return 0;
+  }
+  auto chunks = split(values.size() - windowSize);
+  std::vector<int> counts(chunks.size(), 0);
+  pool_->run(chunks.size(), [&](std::size_t i) {
+    auto [begin, end] = chunks[i];
+    counts[i] = kernels_->countGreater(values.data() + windowSize + begin, values.data() + begin, end - begin);
+  });
+  return std::accumulate(counts.begin(), counts.end(), 0);
+}
+
+int HostEngine::dive(const std::vector<int>& records) const {
+  auto chunks = split(records.size());
+  std::vector<std::array<int, 3>> sums(chunks.size(), {0, 0, 0});
+  pool_->run(chunks.size(), [&](std::size_t i) {
+    kernels_->sumByOpcode(records.data() + chunks[i].begin, chunks[i].end - chunks[i].begin, sums[i].data());
+  });
+
+  unsigned total[3] = {0, 0, 0};
+  for (const auto& chunkSums : sums) {
+    for (int opcode = 0; opcode < 3; ++opcode) {
+      total[opcode] += unsigned(chunkSums[opcode]);
+    }
+  }
+  return int(total[FORWARD] * (total[DOWN] - total[UP]));
+}
+
+int HostEngine::diveWithAim(const std::vector<int>& records) const {
+  auto chunks = split(records.size());
+
+  //
+  // First the sums of each chunk, which give the forward total and how much each
+  // chunk changes the aim
+  //
+  std::vector<std::array<int, 3>> sums(chunks.size(), {0, 0, 0});
+  pool_->run(chunks.size(), [&](std::size_t i) {
+    kernels_->sumByOpcode(records.data() + chunks[i].begin, chunks[i].end - chunks[i].begin, sums[i].data());
+  });
+
+  //
+  // The aim into each chunk is the sum of the changes of the chunks before it
+  //
+  unsigned forward = 0;
+  std::vector<int> aims(chunks.size());
+  unsigned aim = 0;
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    aims[i] = int(aim);
+    aim += unsigned(sums[i][DOWN]) - unsigned(sums[i][UP]);
+    forward += unsigned(sums[i][FORWARD]);
+  }
+
+  //
+  // Then each chunk's depth starting from its aim
+  //
+  std::vector<int> depths(chunks.size(), 0);
+  pool_->run(chunks.size(), [&](std::size_t i) {
+    depths[i] = kernels_->aimedDepth(records.data() + chunks[i].begin, chunks[i].end - chunks[i].begin, aims[i]);
+  });
+
+  unsigned depth = 0;
+  for (int chunkDepth : depths) {
+    depth += unsigned(chunkDepth);
+  }
+  return int(forward * depth);
+}
+
+long long HostEngine::diveWide(const std::vector<int>& records) const {
+  long long sums[3] = {0, 0, 0};
+  for (int record : records) {
+    sums[record & 3] += unsigned(record) >> 2;
+  }
+  return MulWide(sums[FORWARD], sums[DOWN] - sums[UP]);
+}
+
+long long HostEngine::diveWithAimWide(const std::vector<int>& records) const {
+  long long forward = 0;
+  long long depth = 0;
+  unsigned aim = 0;
+  for (int record : records) {
+    unsigned value = unsigned(record) >> 2;
+    switch (record & 3) {
+    case FORWARD: forward += value; depth += (long long)value * int(aim); break;
+    case UP: aim -= value; break;
+    case DOWN: aim += value; break;
+    default: break;
+    }
+  }
+  return MulWide(forward, depth);
+}
+
+long long HostEngine::powerConsumption(const PackedBits& packed) const {
+  auto chunks = split(packed.numRows);
+  std::vector<std::vector<unsigned>> chunkCounts(chunks.size(), std::vector<unsigned>(packed.numCols, 0));
+  pool_->run(chunks.size(), [&](std::size_t i) {
+    kernels_->countBits(packed.words.data() + chunks[i].begin, chunks[i].end - chunks[i].begin,
+                        packed.numCols, chunkCounts[i].data());
+  });
+
+  unsigned gamma = 0;
+  for (unsigned col = 0; col < packed.numCols; ++col) {
+    std::size_t count = 0;
+    for (const auto& counts : chunkCounts) {
+      count += counts[col];
+    }
+    gamma = gamma * 2 + (count * 2 > packed.numRows);
+  }
+  unsigned allBits = packed.numCols >= 32 ? 0xffffffffU : (1U << packed.numCols) - 1;
+  return MulWide(gamma, allBits - gamma);
+}
+
+long long HostEngine::lifeSupportRating(const PackedBits& packed) const {
+  //
+  // Sort each chunk, then merge neighbouring pairs of sorted runs until there is one
+  //
+  std::vector<unsigned> sorted = packed.words;
+  auto chunks = split(sorted.size());
+  pool_->run(chunks.size(), [&](std::size_t i) {
+    std::sort(sorted.begin() + chunks[i].begin, sorted.begin() + chunks[i].end);
+  });
+  for (std::size_t width = 1; width < chunks.size(); width *= 2) {
+    pool_->run((chunks.size() + 2 * width - 1) / (2 * width), [&](std::size_t pair) {
+      std::size_t first = pair * 2 * width;
+      std::size_t middle = first + width;
+      std::size_t last = std::min(first + 2 * width, chunks.size());
+      if (middle < last) {
+        std::inplace_merge(sorted.begin() + chunks[first].begin,
+                           sorted.begin() + chunks[middle].begin,
+                           sorted.begin() + chunks[last - 1].end);
+      }
+    });
+  }
+
+  unsigned ratings[2];
+  pool_->run(2, [&](std::size_t i) {
+    ratings[i] = FindRating(sorted, packed.numCols, i == 0);
+  });
+  return MulWide(ratings[0], ratings[1]);
+}
+
+bool UseHostBackend(const Options& options) {
+  if (options.get("backend") != "host") {
+    return false;
+  }
+  if (options.has("generate")) {
+    throw std::invalid_argument("--generate makes the input on the device, so needs a device backend");
+  }
+  return true;
+}
+
+bool CheckResult(const HostEngine& host, long long deviceResult, long long hostResult) {
+  bool match = deviceResult == hostResult;
+  std::cout << "Host check (" << host.getIsa() << "): "
+            << (match ? "OK" : "MISMATCH, host result = " + std::to_string(hostResult)) << "\n";
+  return match;
+}
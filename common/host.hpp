@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <host_kernels.hpp>
+#include <input.hpp>
+#include <options.hpp>
+#include <threads.hpp>
+
+//
+// The puzzles computed on the host, with --backend=host, or as a check of the device
+// result with --check.
+//
+// They read the same parsed buffers that are copied to the device and use the same
+// 32-bit arithmetic, so the results match the device exactly. The kernels are
+// vectorised with the widest instruction set the CPU has (AVX-512, AVX2 or none),
+// which can be chosen with --isa=avx512|avx2|scalar.
+//
+// Large inputs are split into a chunk per thread (--threads, default all the cores),
+// with what crosses the chunk boundaries carried between them:
+//   day 1   - each chunk compares its first measurement with the last of the chunk
+//             before it
+//   day 2   - the per-chunk sums are added up. For the aim each chunk first sums its
+//             own aim changes, a scan of those gives the aim into each chunk, and then
+//             the chunks compute their depths from that
+//   day 3   - each chunk counts its own bits and the counts are added up. For the
+//             ratings the chunks are sorted in parallel and merged in pairs
+//
+class HostEngine {
+public:
+  explicit HostEngine(const Options& options);
+
+  const std::string& getIsa() const { return isa_; }
+  unsigned getThreads() const { return pool_->size(); }
+
+  // Day 1
+  int countIncreases(const std::vector<int>& values) const;
+  int countWindowIncreases(const std::vector<int>& values, std::size_t windowSize) const;
+
+  // Day 2, from packed (value << 2 | opcode) records
+  int dive(const std::vector<int>& records) const;
+  int diveWithAim(const std::vector<int>& records) const;
+
+  // Day 2 with --wide, with the sums and products in 64 bits (the aim stays 32-bit, as
+  // on the device). Scalar, for checking the device's wide results.
+  long long diveWide(const std::vector<int>& records) const;
+  long long diveWithAimWide(const std::vector<int>& records) const;
+
+  // Day 3, with the product of the two 32-bit factors in 64 bits as on the host side
+  // of the device run
+  long long powerConsumption(const PackedBits& packed) const;
+  long long lifeSupportRating(const PackedBits& packed) const;
+
+private:
+  struct Chunk {
+    std::size_t begin;
+    std::size_t end;
+  };
+  std::vector<Chunk> split(std::size_t n) const;
+
+  std::string isa_;
+  const HostKernels* kernels_;
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+//
+// True when --backend=host. The host backend reads the input file, so this throws
+// std::invalid_argument when the input is to be generated on the device.
+//
+bool UseHostBackend(const Options& options);
+
+//
+// Check a device result against the host with --check, returns false if it does not
+// match.
+//
+bool CheckResult(const HostEngine& host, long long deviceResult, long long hostResult);
@@ -0,0 +1,57 @@
+#include <cstddef>
+#include <immintrin.h>
+
+//
+// Everything from here on is compiled for AVX2, it is only called when the CPU has it
+//
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include <host_kernels.hpp>
+
+namespace {
+
+struct Avx2 {
+  using Vec = __m256i;
+  static constexpr std::size_t width = 8;
+
+  static Vec load(const int* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  static Vec set1(int x) { return _mm256_set1_epi32(x); }
+  static Vec zero() { return _mm256_setzero_si256(); }
+  static Vec add(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+  static Vec sub(Vec a, Vec b) { return _mm256_sub_epi32(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm256_mullo_epi32(a, b); }
+  static Vec shr(Vec a, int n) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+  static Vec bitAnd(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+  static Vec selectGreater(Vec a, Vec b, Vec x) { return _mm256_and_si256(_mm256_cmpgt_epi32(a, b), x); }
+  static Vec selectEqual(Vec a, Vec b, Vec x) { return _mm256_and_si256(_mm256_cmpeq_epi32(a, b), x); }
+
+  //
+  // Inclusive prefix sum of the lanes. Scan each 128-bit half, then add the last lane
+  // of the low half to the high half.
+  //
+  static Vec scan(Vec x) {
+    x = add(x, _mm256_slli_si256(x, 4));
+    x = add(x, _mm256_slli_si256(x, 8));
+    Vec lowHalf = _mm256_permute2x128_si256(x, x, 0x08);
+    return add(x, _mm256_shuffle_epi32(lowHalf, 0xff));
+  }
+
+  static int last(Vec x) { return _mm256_extract_epi32(x, 7); }
+
+  static int sum(Vec x) {
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    return _mm_cvtsi128_si32(s);
+  }
+};
+
+} // namespace
+
+const HostKernels& Avx2Kernels() {
+  static const HostKernels kernels = host_kernels::MakeKernels<Avx2>();
+  return kernels;
+}
+
+#pragma GCC pop_options
@@ -0,0 +1,51 @@
+#include <cstddef>
+#include <immintrin.h>
+
+//
+// Everything from here on is compiled for AVX-512, it is only called when the CPU has it
+//
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+#include <host_kernels.hpp>
+
+namespace {
+
+struct Avx512 {
+  using Vec = __m512i;
+  static constexpr std::size_t width = 16;
+
+  static Vec load(const int* p) { return _mm512_loadu_si512(p); }
+  static Vec set1(int x) { return _mm512_set1_epi32(x); }
+  static Vec zero() { return _mm512_setzero_si512(); }
+  static Vec add(Vec a, Vec b) { return _mm512_add_epi32(a, b); }
+  static Vec sub(Vec a, Vec b) { return _mm512_sub_epi32(a, b); }
+  static Vec mul(Vec a, Vec b) { return _mm512_mullo_epi32(a, b); }
+  static Vec shr(Vec a, int n) { return _mm512_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+  static Vec bitAnd(Vec a, Vec b) { return _mm512_and_si512(a, b); }
+  static Vec selectGreater(Vec a, Vec b, Vec x) { return _mm512_maskz_mov_epi32(_mm512_cmpgt_epi32_mask(a, b), x); }
+  static Vec selectEqual(Vec a, Vec b, Vec x) { return _mm512_maskz_mov_epi32(_mm512_cmpeq_epi32_mask(a, b), x); }
+
+  //
+  // Inclusive prefix sum of the lanes, adding the lanes shifted up by 1, 2, 4 and 8
+  //
+  static Vec scan(Vec x) {
+    x = add(x, _mm512_alignr_epi32(x, zero(), 15));
+    x = add(x, _mm512_alignr_epi32(x, zero(), 14));
+    x = add(x, _mm512_alignr_epi32(x, zero(), 12));
+    x = add(x, _mm512_alignr_epi32(x, zero(), 8));
+    return x;
+  }
+
+  static int last(Vec x) { return _mm_extract_epi32(_mm512_extracti32x4_epi32(x, 3), 3); }
+  static int sum(Vec x) { return _mm512_reduce_add_epi32(x); }
+};
+
+} // namespace
+
+const HostKernels& Avx512Kernels() {
+  static const HostKernels kernels = host_kernels::MakeKernels<Avx512>();
+  return kernels;
+}
+
+#pragma GCC pop_options
@@ -0,0 +1,206 @@
+#pragma once
+
+//
+// The host kernels, written once over an instruction set (S) and compiled for each of
+// them by host_scalar.cpp, host_avx2.cpp and host_avx512.cpp.
+//
+// S provides a vector of S::width 32-bit lanes (S::Vec) and the operations on it. All
+// the arithmetic wraps like the 32-bit arithmetic on the device, so the host and
+// device results can be compared exactly.
+//
+// The instruction set files include this after switching on their instruction set
+// with #pragma GCC target, so it must not include any headers the files have not
+// already included (or inline functions from them could be compiled for the wrong
+// instruction set).
+//
+#include <cstddef>
+
+//
+// The kernels for one instruction set. Each works on a chunk of the input and
+// carries whatever crosses the chunk boundary, so a day can be split over threads.
+//
+struct HostKernels {
+  // Count of values[i] > values[i - 1], with values[-1] = previous
+  int (*countIncreases)(const int* values, std::size_t n, int previous);
+
+  // Count of a[i] > b[i]
+  int (*countGreater)(const int* a, const int* b, std::size_t n);
+
+  // Add the values of the packed (value << 2 | opcode) records to sums[opcode]
+  void (*sumByOpcode)(const int* records, std::size_t n, int* sums);
+
+  // Sum of value * aim over the forward records, with aim the running total of the
+  // down values minus the up values. aim is carried in and out.
+  int (*aimedDepth)(const int* records, std::size_t n, int& aim);
+
+  // Add the number of 1's in each of the numCols bits of the words to counts, with
+  // counts[0] the most significant bit
+  void (*countBits)(const unsigned* words, std::size_t n, unsigned numCols, unsigned* counts);
+};
+
+namespace host_kernels {
+
+// Opcodes of the packed records, as Opcode in input.hpp
+constexpr int kForward = 0;
+constexpr int kUp = 1;
+constexpr int kDown = 2;
+
+template <class S>
+int CountIncreases(const int* values, std::size_t n, int previous) {
+  if (n == 0) {
+    return 0;
+  }
+  int count = values[0] > previous;
+
+  std::size_t i = 1;
+  typename S::Vec one = S::set1(1);
+  typename S::Vec counts = S::zero();
+  for (; i + S::width <= n; i += S::width) {
+    counts = S::add(counts, S::selectGreater(S::load(values + i), S::load(values + i - 1), one));
+  }
+  count += S::sum(counts);
+
+  for (; i < n; ++i) {
+    count += values[i] > values[i - 1];
+  }
+  return count;
+}
+
+template <class S>
+int CountGreater(const int* a, const int* b, std::size_t n) {
+  std::size_t i = 0;
+  typename S::Vec one = S::set1(1);
+  typename S::Vec counts = S::zero();
+  for (; i + S::width <= n; i += S::width) {
+    counts = S::add(counts, S::selectGreater(S::load(a + i), S::load(b + i), one));
+  }
+  int count = S::sum(counts);
+
+  for (; i < n; ++i) {
+    count += a[i] > b[i];
+  }
+  return count;
+}
+
+template <class S>
+void SumByOpcode(const int* records, std::size_t n, int* sums) {
+  std::size_t i = 0;
+  typename S::Vec three = S::set1(3);
+  typename S::Vec forward = S::set1(kForward);
+  typename S::Vec up = S::set1(kUp);
+  typename S::Vec down = S::set1(kDown);
+  typename S::Vec forwardSums = S::zero();
+  typename S::Vec upSums = S::zero();
+  typename S::Vec downSums = S::zero();
+  for (; i + S::width <= n; i += S::width) {
+    typename S::Vec record = S::load(records + i);
+    typename S::Vec value = S::shr(record, 2);
+    typename S::Vec opcode = S::bitAnd(record, three);
+    forwardSums = S::add(forwardSums, S::selectEqual(opcode, forward, value));
+    upSums = S::add(upSums, S::selectEqual(opcode, up, value));
+    downSums = S::add(downSums, S::selectEqual(opcode, down, value));
+  }
+
+  unsigned totals[3] = {unsigned(S::sum(forwardSums)), unsigned(S::sum(upSums)), unsigned(S::sum(downSums))};
+  for (; i < n; ++i) {
+    totals[records[i] & 3] += unsigned(records[i]) >> 2;
+  }
+  for (int opcode = 0; opcode < 3; ++opcode) {
+    sums[opcode] = int(unsigned(sums[opcode]) + totals[opcode]);
+  }
+}
+
+//
+// The aim before each record is the aim carried in plus the exclusive prefix sum of
+// the aim changes, which is a scan within each vector plus the total of the vectors
+// before it.
+//
+template <class S>
+int AimedDepth(const int* records, std::size_t n, int& aim) {
+  std::size_t i = 0;
+  typename S::Vec three = S::set1(3);
+  typename S::Vec forward = S::set1(kForward);
+  typename S::Vec up = S::set1(kUp);
+  typename S::Vec down = S::set1(kDown);
+  typename S::Vec carry = S::set1(aim);
+  typename S::Vec depths = S::zero();
+  for (; i + S::width <= n; i += S::width) {
+    typename S::Vec record = S::load(records + i);
+    typename S::Vec value = S::shr(record, 2);
+    typename S::Vec opcode = S::bitAnd(record, three);
+    typename S::Vec change = S::sub(S::selectEqual(opcode, down, value), S::selectEqual(opcode, up, value));
+    typename S::Vec aimAfter = S::add(S::scan(change), carry);
+    typename S::Vec aimBefore = S::sub(aimAfter, change);
+    depths = S::add(depths, S::mul(S::selectEqual(opcode, forward, value), aimBefore));
+    carry = S::set1(S::last(aimAfter));
+  }
+
+  unsigned depth = unsigned(S::sum(depths));
+  unsigned aimNow = unsigned(S::last(carry));
+  for (; i < n; ++i) {
+    unsigned value = unsigned(records[i]) >> 2;
+    switch (records[i] & 3) {
+    case kForward: depth += value * aimNow; break;
+    case kUp: aimNow -= value; break;
+    case kDown: aimNow += value; break;
+    default: break;
+    }
+  }
+  aim = int(aimNow);
+  return int(depth);
+}
+
+//
+// Bits is the width of the rows for the widths with their own instantiation (see
+// specialisedWidths in input.hpp), so the loops over the bits unroll with constant
+// shifts. It is 0 for any other width, taken from numCols.
+//
+template <class S, unsigned Bits>
+void CountBitsFixed(const unsigned* words, std::size_t n, unsigned numCols, unsigned* counts) {
+  const unsigned numBits = Bits ? Bits : numCols;
+  std::size_t i = 0;
+  typename S::Vec one = S::set1(1);
+  typename S::Vec bitCounts[32];
+  for (unsigned bit = 0; bit < numBits; ++bit) {
+    bitCounts[bit] = S::zero();
+  }
+  for (; i + S::width <= n; i += S::width) {
+    typename S::Vec word = S::load(reinterpret_cast<const int*>(words + i));
+    for (unsigned bit = 0; bit < numBits; ++bit) {
+      bitCounts[bit] = S::add(bitCounts[bit], S::bitAnd(S::shr(word, bit), one));
+    }
+  }
+
+  for (unsigned bit = 0; bit < numBits; ++bit) {
+    unsigned count = unsigned(S::sum(bitCounts[bit]));
+    for (std::size_t j = i; j < n; ++j) {
+      count += (words[j] >> bit) & 1;
+    }
+    counts[numBits - 1 - bit] += count;
+  }
+}
+
+template <class S>
+void CountBits(const unsigned* words, std::size_t n, unsigned numCols, unsigned* counts) {
+  switch (numCols) {
+  case 8: CountBitsFixed<S, 8>(words, n, numCols, counts); break;
+  case 12: CountBitsFixed<S, 12>(words, n, numCols, counts); break;
+  case 16: CountBitsFixed<S, 16>(words, n, numCols, counts); break;
+  case 32: CountBitsFixed<S, 32>(words, n, numCols, counts); break;
+  default: CountBitsFixed<S, 0>(words, n, numCols, counts); break;
+  }
+}
+
+template <class S>
+HostKernels MakeKernels() {
+  return {CountIncreases<S>, CountGreater<S>, SumByOpcode<S>, AimedDepth<S>, CountBits<S>};
+}
+
+} // namespace host_kernels
+
+//
+// The kernels for each instruction set
+//
+const HostKernels& ScalarKernels();
+const HostKernels& Avx2Kernels();
+const HostKernels& Avx512Kernels();
@@ -0,0 +1,33 @@
+#include <cstddef>
+#include <host_kernels.hpp>
+
+namespace {
+
+//
+// One lane, for CPUs without AVX2. Arithmetic is done unsigned so it wraps.
+//
+struct Scalar {
+  using Vec = int;
+  static constexpr std::size_t width = 1;
+
+  static Vec load(const int* p) { return *p; }
+  static Vec set1(int x) { return x; }
+  static Vec zero() { return 0; }
+  static Vec add(Vec a, Vec b) { return int(unsigned(a) + unsigned(b)); }
+  static Vec sub(Vec a, Vec b) { return int(unsigned(a) - unsigned(b)); }
+  static Vec mul(Vec a, Vec b) { return int(unsigned(a) * unsigned(b)); }
+  static Vec shr(Vec a, int n) { return int(unsigned(a) >> n); }
+  static Vec bitAnd(Vec a, Vec b) { return a & b; }
+  static Vec selectGreater(Vec a, Vec b, Vec x) { return a > b ? x : 0; }
+  static Vec selectEqual(Vec a, Vec b, Vec x) { return a == b ? x : 0; }
+  static Vec scan(Vec x) { return x; }
+  static int last(Vec x) { return x; }
+  static int sum(Vec x) { return x; }
+};
+
+} // namespace
+
+const HostKernels& ScalarKernels() {
+  static const HostKernels kernels = host_kernels::MakeKernels<Scalar>();
+  return kernels;
+}
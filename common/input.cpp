@@ -0,0 +1,280 @@
+#include <input.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "Could not open " + path);
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    int err = errno;
+    ::close(fd);
+    throw std::system_error(err, std::generic_category(), "Could not stat " + path);
+  }
+
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "Could not map " + path);
+    }
+    // We read the file front to back exactly once
+    ::madvise(data, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(data);
+  }
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    ::munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+const char* FindNewline(const char* begin, const char* end) {
+#ifdef __SSE2__
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (end - begin >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+    if (mask) {
+      return begin + __builtin_ctz(mask);
+    }
+    begin += 16;
+  }
+#endif
+  const void* found = std::memchr(begin, '\n', end - begin);
+  return found ? static_cast<const char*>(found) : end;
+}
+
+std::size_t CountLines(std::string_view data) {
+  std::size_t count = 0;
+  ForEachLine(data, [&](std::string_view) { ++count; });
+  return count;
+}
+
+namespace {
+
+int ParseInt(std::string_view text) {
+  int value = 0;
+  auto begin = text.data();
+  auto end = begin + text.size();
+  if (begin != end && *begin == '+') {
+    ++begin;
+  }
+  auto result = std::from_chars(begin, end, value);
+  if (result.ec != std::errc() || result.ptr != end) {
+    throw std::invalid_argument("Expected an integer but found '" + std::string(text) + "'");
+  }
+  return value;
+}
+
+//
+// Parse a "command value" line, returning the value and setting the opcode
+//
+int ParseCommand(std::string_view line, unsigned char& opcode) {
+  auto space = line.find(' ');
+  if (space == std::string_view::npos) {
+    throw std::invalid_argument("Expected 'command value' but found '" + std::string(line) + "'");
+  }
+
+  //
+  // The commands differ in their first letter so that is all we need to look at
+  //
+  switch (line[0]) {
+    case 'f': opcode = FORWARD; break;
+    case 'u': opcode = UP; break;
+    case 'd': opcode = DOWN; break;
+    default:
+      throw std::invalid_argument("Unknown command in '" + std::string(line) + "'");
+  }
+  int value = ParseInt(line.substr(space + 1));
+  if (value < 0 || value > maxCommandValue) {
+    throw std::invalid_argument("Command values must be from 0 to " + std::to_string(maxCommandValue) +
+                                ", found '" + std::string(line) + "'");
+  }
+  return value;
+}
+
+//
+// Reverse the order of the bits in a byte, the first character of a line is the most
+// significant bit but comes out of the SIMD compare as the least significant
+//
+unsigned char ReverseByte(unsigned char b) {
+  b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+  b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+  b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+  return b;
+}
+
+//
+// Convert a line of up to 32 '0'/'1' characters to a word. available is how many bytes
+// can be read from the start of the line, which may be more than the line when it is
+// not the last one in the file.
+//
+unsigned BitsToWord(std::string_view line, std::size_t available) {
+  unsigned word = 0;
+  std::size_t i = 0;
+#ifdef __SSE2__
+  //
+  // Compare 16 characters at a time with '1', the mask has a bit set for each '1'
+  //
+  const __m128i one = _mm_set1_epi8('1');
+  while (i < line.size() && available - i >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line.data() + i));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, one));
+    unsigned reversed = ReverseByte(mask & 0xFF) << 8 | ReverseByte(mask >> 8);
+    std::size_t n = std::min<std::size_t>(16, line.size() - i);
+    word = (word << n) | (reversed >> (16 - n));
+    i += n;
+  }
+#endif
+  for (; i < line.size(); ++i) {
+    word = (word << 1) | (line[i] == '1');
+  }
+  return word;
+}
+
+} // namespace
+
+std::vector<int> ParseIntegers(std::string_view data) {
+  std::vector<int> values(CountLines(data));
+  auto out = values.begin();
+  ForEachLine(data, [&](std::string_view line) {
+    *out++ = ParseInt(line);
+  });
+  return values;
+}
+
+IntegerReader::IntegerReader(std::string_view data)
+    : pos_(data.data()), end_(data.data() + data.size()) {}
+
+std::size_t IntegerReader::read(int* out, std::size_t max) {
+  std::size_t count = 0;
+  while (count < max && pos_ < end_) {
+    const char* eol = FindNewline(pos_, end_);
+    std::string_view line(pos_, eol - pos_);
+    pos_ = eol + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (!line.empty()) {
+      out[count++] = ParseInt(line);
+    }
+  }
+  return count;
+}
+
+Commands ParseCommands(std::string_view data) {
+  Commands commands;
+  auto numCommands = CountLines(data);
+  commands.opcodes.resize(numCommands);
+  commands.values.resize(numCommands);
+
+  std::size_t i = 0;
+  ForEachLine(data, [&](std::string_view line) {
+    commands.values[i] = ParseCommand(line, commands.opcodes[i]);
+    ++i;
+  });
+  return commands;
+}
+
+std::vector<int> ParsePackedCommands(std::string_view data) {
+  std::vector<int> records(CountLines(data));
+  auto out = records.begin();
+  ForEachLine(data, [&](std::string_view line) {
+    unsigned char opcode;
+    int value = ParseCommand(line, opcode);
+    *out++ = PackCommand(static_cast<Opcode>(opcode), value);
+  });
+  return records;
+}
+
+BitMatrix ParseBitMatrix(std::string_view data) {
+  BitMatrix matrix;
+  matrix.numRows = CountLines(data);
+
+  std::size_t row = 0;
+  ForEachLine(data, [&](std::string_view line) {
+    //
+    // The first row sets the number of columns
+    //
+    if (row == 0) {
+      matrix.numCols = line.size();
+      matrix.bits.resize(matrix.numRows * matrix.numCols);
+    }
+    if (line.size() != matrix.numCols) {
+      throw std::invalid_argument("All rows must have " + std::to_string(matrix.numCols) + " bits, found '" + std::string(line) + "'");
+    }
+
+    int* out = &matrix.bits[row * matrix.numCols];
+    for (char c : line) {
+      *out++ = c == '0' ? 0 : 1;
+    }
+    ++row;
+  });
+  return matrix;
+}
+
+namespace {
+
+//
+// Pack the rows, all Bits wide (or when Bits is 0, numCols wide). With Bits constant
+// the length of each line is too, so BitsToWord compiles to a fixed number of blocks.
+//
+template <unsigned Bits>
+void PackRows(std::string_view data, PackedBits& packed) {
+  const std::size_t numCols = Bits ? Bits : packed.numCols;
+  const char* end = data.data() + data.size();
+  std::size_t row = 0;
+  ForEachLine(data, [&](std::string_view line) {
+    if (line.size() != numCols) {
+      throw std::invalid_argument("All rows must have " + std::to_string(numCols) + " bits, found '" + std::string(line) + "'");
+    }
+    packed.words[row++] = BitsToWord(std::string_view(line.data(), numCols), end - line.data());
+  });
+}
+
+} // namespace
+
+PackedBits ParsePackedBits(std::string_view data) {
+  PackedBits packed;
+  packed.numRows = CountLines(data);
+  packed.words.resize(packed.numRows);
+
+  //
+  // The first row sets the number of columns
+  //
+  std::size_t first = std::min(data.find_first_not_of("\r\n"), data.size());
+  packed.numCols = FindNewline(data.data() + first, data.data() + data.size()) - (data.data() + first);
+  if (packed.numCols > 0 && data[first + packed.numCols - 1] == '\r') {
+    --packed.numCols;
+  }
+  if (packed.numCols > 32) {
+    throw std::invalid_argument("Rows can be at most 32 bits, found " + std::to_string(packed.numCols));
+  }
+
+  switch (packed.numCols) {
+  case 8: PackRows<8>(data, packed); break;
+  case 12: PackRows<12>(data, packed); break;
+  case 16: PackRows<16>(data, packed); break;
+  case 32: PackRows<32>(data, packed); break;
+  default: PackRows<0>(data, packed); break;
+  }
+  return packed;
+}
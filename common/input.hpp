@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+// Read only memory mapping of an input file. The contents are parsed in place, there
+// is no copy into std::string lines.
+//
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view contents() const { return {data_, size_}; }
+  std::size_t size() const { return size_; }
+
+private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+//
+// Find the next '\n' in [begin, end), returns end if there is none. Uses SSE2 to
+// compare 16 bytes at a time when available.
+//
+const char* FindNewline(const char* begin, const char* end);
+
+//
+// Number of non empty lines, used to size the output buffers before parsing
+//
+std::size_t CountLines(std::string_view data);
+
+//
+// Call fn(std::string_view line) for each non empty line, without the line ending
+//
+template <typename Fn>
+void ForEachLine(std::string_view data, Fn&& fn) {
+  const char* p = data.data();
+  const char* end = p + data.size();
+  while (p < end) {
+    const char* eol = FindNewline(p, end);
+    const char* last = eol;
+    if (last > p && last[-1] == '\r') {
+      --last;
+    }
+    if (last > p) {
+      fn(std::string_view(p, last - p));
+    }
+    p = eol + 1;
+  }
+}
+
+//
+// Day 1 - one integer per line
+//
+std::vector<int> ParseIntegers(std::string_view data);
+
+//
+// Parses the integers a chunk at a time, for inputs too large to hold in memory
+//
+class IntegerReader {
+public:
+  explicit IntegerReader(std::string_view data);
+
+  // Parse up to max integers into out, returns how many were parsed
+  std::size_t read(int* out, std::size_t max);
+
+private:
+  const char* pos_;
+  const char* end_;
+};
+
+//
+// Day 2 - "command value" lines. The opcodes and values are kept in separate arrays
+// so they can be copied straight to the device.
+//
+enum Opcode : unsigned char {
+  FORWARD = 0,
+  UP = 1,
+  DOWN = 2,
+};
+
+struct Commands {
+  std::vector<unsigned char> opcodes;
+  std::vector<int> values;
+};
+
+Commands ParseCommands(std::string_view data);
+
+//
+// The commands packed one per int, with the opcode in the bottom 2 bits and the
+// value above it. This is the layout streamed to the device, which decodes it. So
+// the values must be in [0, maxCommandValue], which the parsers check, and the
+// record is always non-negative. Both the host and the device decode the value with
+// an unsigned (logical) shift.
+//
+const int maxCommandValue = (1 << 29) - 1;
+
+inline int PackCommand(Opcode opcode, int value) {
+  return static_cast<int>((static_cast<unsigned>(value) << 2) | opcode);
+}
+
+std::vector<int> ParsePackedCommands(std::string_view data);
+
+//
+// Day 3 - lines of '0' and '1' characters, flattened row major with one int per bit
+//
+struct BitMatrix {
+  std::size_t numRows = 0;
+  std::size_t numCols = 0;
+  std::vector<int> bits;
+};
+
+BitMatrix ParseBitMatrix(std::string_view data);
+
+//
+// Day 3 - the same lines packed into one word per row, with the first character as the
+// most significant bit. Rows can be up to 32 bits wide.
+//
+// The common widths have their own instantiations of the packing here, and of the bit
+// counting on the host (host_kernels.hpp) and on the device (the CountBits vertex), with
+// the width a constant. The width is chosen from the first line. Other widths use the
+// generic code.
+//
+constexpr unsigned specialisedWidths[] = {8, 12, 16, 32};
+
+inline bool IsSpecialisedWidth(std::size_t numCols) {
+  for (unsigned width : specialisedWidths) {
+    if (width == numCols) {
+      return true;
+    }
+  }
+  return false;
+}
+
+struct PackedBits {
+  std::size_t numRows = 0;
+  std::size_t numCols = 0;
+  std::vector<unsigned> words;
+};
+
+PackedBits ParsePackedBits(std::string_view data);
@@ -0,0 +1,50 @@
+#include <mapping.hpp>
+#include <algorithm>
+#include <numeric>
+#include <poputil/TileMapping.hpp>
+
+using namespace poplar;
+
+namespace {
+
+//
+// Below this many bytes per tile the cost of the vertex outweighs the work
+//
+const unsigned minBytesPerTile = 128;
+
+unsigned GrainSize(const Target& target, const Type& type) {
+  unsigned vectorWidth = target.getVectorWidth(type);
+  unsigned typeSize = target.getTypeSize(type);
+  unsigned atomicElements = std::max(1U, target.getAtomicStoreGranularity() / typeSize);
+  return std::lcm(vectorWidth, atomicElements);
+}
+
+//
+// Map with grains of grainSize elements, using as many tiles as possible while
+// keeping at least minBytesPerTile on each
+//
+void MapWithGrain(Graph& graph, const Tensor& tensor, unsigned grainSize) {
+  const Target& target = graph.getTarget();
+  unsigned typeSize = target.getTypeSize(tensor.elementType());
+  unsigned minGrains = std::max(1U, minBytesPerTile / (grainSize * typeSize));
+  poputil::mapTensorLinearly(graph, tensor, minGrains * grainSize, grainSize);
+}
+
+} // namespace
+
+void MapTensorBalanced(Graph& graph, const Tensor& tensor) {
+  MapWithGrain(graph, tensor, GrainSize(graph.getTarget(), tensor.elementType()));
+}
+
+//
+// mapTensorLinearly deals out the grains evenly, with at least minGrains on a tile
+//
+std::size_t BalancedElementsPerTile(const Target& target, std::size_t numElements, const Type& type, unsigned numTiles) {
+  unsigned grainSize = GrainSize(target, type);
+  unsigned typeSize = target.getTypeSize(type);
+  std::size_t minGrains = std::max(1U, minBytesPerTile / (grainSize * typeSize));
+  std::size_t numGrains = (numElements + grainSize - 1) / grainSize;
+  std::size_t grainsPerTile = std::max(minGrains, (numGrains + numTiles - 1) / std::max(1U, numTiles));
+  return std::min(numElements, grainsPerTile * grainSize);
+}
+
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <poplar/Graph.hpp>
+#include <poplar/Tensor.hpp>
+
+//
+// Spread a tensor evenly over all the tiles of the graph, whatever its size.
+//
+// Elements are placed in grains that are a whole number of vectors for the element
+// type (and never split a 32-bit word between tiles for the smaller types). Small
+// tensors are kept to a minimum number of bytes per tile so they use fewer tiles
+// rather than putting a single element on each one.
+//
+void MapTensorBalanced(poplar::Graph& graph, const poplar::Tensor& tensor);
+
+//
+// The most elements MapTensorBalanced puts on one tile for a tensor of numElements of
+// type spread over numTiles tiles, so the tile memory can be estimated before the
+// graph is built (see fit.hpp)
+//
+std::size_t BalancedElementsPerTile(const poplar::Target& target, std::size_t numElements,
+                                    const poplar::Type& type, unsigned numTiles);
+
@@ -0,0 +1,59 @@
+#include <options.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+std::string EnvironmentName(const std::string& name) {
+  std::string env = "AOC_" + name;
+  std::transform(env.begin(), env.end(), env.begin(), [](unsigned char c) {
+    return c == '-' ? '_' : std::toupper(c);
+  });
+  return env;
+}
+
+} // namespace
+
+Options::Options(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind("--", 0) != 0) {
+      std::cerr << "Ignoring unexpected argument " << arg << "\n";
+      continue;
+    }
+    auto equals = arg.find('=');
+    if (equals == std::string::npos) {
+      values_[arg.substr(2)] = "true";
+    } else {
+      values_[arg.substr(2, equals - 2)] = arg.substr(equals + 1);
+    }
+  }
+}
+
+bool Options::has(const std::string& name) const {
+  return values_.count(name) || std::getenv(EnvironmentName(name).c_str());
+}
+
+std::string Options::get(const std::string& name, const std::string& defaultValue) const {
+  auto it = values_.find(name);
+  if (it != values_.end()) {
+    return it->second;
+  }
+  const char* env = std::getenv(EnvironmentName(name).c_str());
+  return env ? env : defaultValue;
+}
+
+unsigned Options::getUnsigned(const std::string& name, unsigned defaultValue) const {
+  std::string value = get(name);
+  if (value.empty()) {
+    return defaultValue;
+  }
+  try {
+    return std::stoul(value);
+  } catch (const std::exception&) {
+    std::cerr << "Invalid value '" << value << "' for --" << name << ", using " << defaultValue << "\n";
+    return defaultValue;
+  }
+}
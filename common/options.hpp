@@ -0,0 +1,23 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+//
+// Command line options shared by all the days.
+//
+// Options are given on the command line as --name=value (or just --name for a flag).
+// Any option not on the command line is looked up in the environment as AOC_NAME,
+// e.g. --backend=model can also be set with AOC_BACKEND=model.
+//
+class Options {
+public:
+  Options(int argc, char** argv);
+
+  bool has(const std::string& name) const;
+  std::string get(const std::string& name, const std::string& defaultValue = "") const;
+  unsigned getUnsigned(const std::string& name, unsigned defaultValue) const;
+
+private:
+  std::map<std::string, std::string> values_;
+};
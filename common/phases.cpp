@@ -0,0 +1,164 @@
+#include <phases.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+std::string Quote(const std::string& text) {
+  std::ostringstream out;
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+//
+// Nearest-rank percentile of sorted samples
+//
+double Percentile(const std::vector<double>& sorted, double percent) {
+  std::size_t rank = std::size_t(std::ceil(percent / 100.0 * sorted.size()));
+  return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+} // namespace
+
+PhaseTimer::PhaseTimer(const Options& options, const std::string& name)
+  : name_(name),
+    jsonPath_(options.get("json")),
+    repeats_(std::max(1U, options.getUnsigned("repeat", 1))) {
+  setParameter("name", name);
+  setParameter("repeats", repeats_);
+}
+
+void PhaseTimer::start(const std::string& phase) {
+  stop();
+  current_ = phase;
+  start_ = std::chrono::steady_clock::now();
+}
+
+double PhaseTimer::stop() {
+  if (current_.empty()) {
+    return 0;
+  }
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+  auto phase = std::find_if(phases_.begin(), phases_.end(), [&](const Phase& p) { return p.name == current_; });
+  if (phase == phases_.end()) {
+    phases_.push_back({current_, {}});
+    phase = phases_.end() - 1;
+  }
+  phase->samples.push_back(ms);
+  current_.clear();
+  return ms;
+}
+
+void PhaseTimer::setParameter(const std::string& name, const std::string& value) {
+  setJsonParameter(name, Quote(value));
+}
+
+void PhaseTimer::setParameter(const std::string& name, double value) {
+  std::ostringstream out;
+  out << std::setprecision(15) << value;
+  setJsonParameter(name, out.str());
+}
+
+void PhaseTimer::setJsonParameter(const std::string& name, const std::string& json) {
+  for (auto& parameter : parameters_) {
+    if (parameter.first == name) {
+      parameter.second = json;
+      return;
+    }
+  }
+  parameters_.emplace_back(name, json);
+}
+
+void PhaseTimer::setSession(const IpuSession& session) {
+  setParameter("backend", session.getBackend());
+  setParameter("ipus", session.getTarget().getNumIPUs());
+  setParameter("tiles", session.getTarget().getNumTiles());
+}
+
+void PhaseTimer::report() const {
+  //
+  // Summary, one line per phase
+  //
+  std::cout << "Phase timings (ms, " << repeats_ << " repeat" << (repeats_ == 1 ? "" : "s") << ")\n";
+  for (const auto& phase : phases_) {
+    auto sorted = phase.samples;
+    std::sort(sorted.begin(), sorted.end());
+    std::cout << "  " << std::left << std::setw(8) << phase.name << std::right;
+    if (sorted.size() == 1) {
+      std::cout << " " << sorted[0] << "\n";
+    } else {
+      std::cout << " p50 " << Percentile(sorted, 50)
+                << " p90 " << Percentile(sorted, 90)
+                << " p99 " << Percentile(sorted, 99)
+                << " min " << sorted.front()
+                << " max " << sorted.back() << "\n";
+    }
+  }
+
+  if (jsonPath_.empty()) {
+    return;
+  }
+
+  //
+  // JSON, the parameters followed by each phase's statistics and samples
+  //
+  std::ofstream out(jsonPath_);
+  if (!out) {
+    std::cerr << "Could not write timings to " << jsonPath_ << "\n";
+    return;
+  }
+  out << std::setprecision(6) << "{\n";
+  for (const auto& parameter : parameters_) {
+    out << "  " << Quote(parameter.first) << ": " << parameter.second << ",\n";
+  }
+  out << "  \"phases\": {";
+  for (std::size_t i = 0; i < phases_.size(); ++i) {
+    auto sorted = phases_[i].samples;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for (double sample : sorted) {
+      total += sample;
+    }
+    out << (i == 0 ? "\n" : ",\n")
+        << "    " << Quote(phases_[i].name) << ": {"
+        << "\"count\": " << sorted.size()
+        << ", \"mean\": " << total / sorted.size()
+        << ", \"min\": " << sorted.front()
+        << ", \"p50\": " << Percentile(sorted, 50)
+        << ", \"p90\": " << Percentile(sorted, 90)
+        << ", \"p99\": " << Percentile(sorted, 99)
+        << ", \"max\": " << sorted.back()
+        << ", \"samples\": [";
+    for (std::size_t s = 0; s < phases_[i].samples.size(); ++s) {
+      out << (s == 0 ? "" : ", ") << phases_[i].samples[s];
+    }
+    out << "]}";
+  }
+  out << "\n  }\n}\n";
+}
+
+void RunPhases(poplar::Engine& engine, PhaseTimer& timer) {
+  for (unsigned repeat = 0; repeat < timer.getRepeats(); ++repeat) {
+    timer.start("h2d");
+    engine.run(COPY_IN);
+    timer.start("run");
+    engine.run(ALGORITHM);
+    timer.start("d2h");
+    engine.run(COPY_OUT);
+    timer.stop();
+  }
+}
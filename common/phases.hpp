@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+#include <poplar/Engine.hpp>
+
+#include <common.hpp>
+#include <options.hpp>
+
+//
+// Times the phases of a run: parse, device, graph, compile, load and then the
+// host-to-device copy, run and device-to-host copy of each repeat.
+//
+// The repeated phases are run --repeat times (default 1) so they can be given as
+// percentiles. A summary is printed at the end of the run, and with --json=<path> the
+// timings and the parameters of the run (size, backend, tiles) are also written as
+// JSON for bench/ to collect.
+//
+class PhaseTimer {
+public:
+  PhaseTimer(const Options& options, const std::string& name);
+
+  //
+  // Start timing a phase, stopping the previous one if it is still running. stop
+  // returns the time the phase took in ms (0 if none was running).
+  //
+  void start(const std::string& phase);
+  double stop();
+
+  //
+  // Parameters of the run, written with the timings. Setting one again replaces its
+  // value.
+  //
+  void setParameter(const std::string& name, const std::string& value);
+  void setParameter(const std::string& name, double value);
+  void setSession(const IpuSession& session);
+
+  unsigned getRepeats() const { return repeats_; }
+
+  //
+  // Print the summary and write the JSON
+  //
+  void report() const;
+
+private:
+  struct Phase {
+    std::string name;
+    std::vector<double> samples;
+  };
+
+  void setJsonParameter(const std::string& name, const std::string& json);
+
+  std::string name_;
+  std::string jsonPath_;
+  unsigned repeats_;
+  std::vector<Phase> phases_;
+  std::vector<std::pair<std::string, std::string>> parameters_;
+  std::string current_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+//
+// Time f as the given phase --repeat times, returning its result
+//
+template <typename F>
+auto TimeRepeats(PhaseTimer& timer, const std::string& phase, F&& f) {
+  decltype(f()) result{};
+  for (unsigned repeat = 0; repeat < timer.getRepeats(); ++repeat) {
+    timer.start(phase);
+    result = f();
+    timer.stop();
+  }
+  return result;
+}
+
+//
+// The programs the days compile, so the copies and the algorithm can be run and
+// timed separately
+//
+enum ProgramIndex { COPY_IN = 0, ALGORITHM = 1, COPY_OUT = 2, NUM_PROGRAMS = 3 };
+
+//
+// Run the copy in, algorithm and copy out programs the requested number of times,
+// timing each as the h2d, run and d2h phases.
+//
+void RunPhases(poplar::Engine& engine, PhaseTimer& timer);
@@ -0,0 +1,287 @@
+#include <pipeline.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <poplar/Engine.hpp>
+#include <poplar/StreamCallback.hpp>
+
+#include <cache.hpp>
+#include <common.hpp>
+#include <input.hpp>
+#include <mapping.hpp>
+
+using namespace poplar;
+using namespace poplar::program;
+
+namespace {
+
+//
+// Number of parsed inputs the loader keeps ready ahead of the device
+//
+const std::size_t loadAhead = 2;
+
+std::vector<std::string> ReadBatch(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("Could not read the batch " + path);
+  }
+  std::vector<std::string> paths;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty()) {
+      paths.push_back(line);
+    }
+  }
+  if (paths.empty()) {
+    throw std::invalid_argument("The batch " + path + " has no inputs");
+  }
+  return paths;
+}
+
+BatchInput Load(const BatchLoad& load, const std::string& path) {
+  MappedFile data(path);
+  return load(data.contents());
+}
+
+//
+// Feeds the parsed inputs to the "batch" stream. A loader thread parses the inputs
+// after the first into a queue, up to loadAhead ahead of the device.
+//
+// An input is only dropped from the queue once its transfer is complete, as Poplar
+// can discard a prefetched buffer and ask for the same data again.
+//
+// An input that fails to load stops the loader. Its exception is kept and rethrown
+// when the device asks for that input, so it reaches the engine's caller on the main
+// thread like any other error.
+//
+class BatchFeeder : public StreamCallback {
+public:
+  BatchFeeder(const std::vector<std::string>& paths, BatchInput first, BatchLoad load)
+    : paths_(paths), shape_(first.shape), size_(first.bytes.size()), load_(std::move(load)) {
+    ready_.push_back(std::move(first));
+    loader_ = std::thread([this] { loadAll(); });
+  }
+
+  ~BatchFeeder() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    changed_.notify_all();
+    loader_.join();
+  }
+
+  Result prefetch(void* p) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (delivered_ == ready_.size()) {
+      return Result::NotAvailable;
+    }
+    deliver(p);
+    return Result::Success;
+  }
+
+  void fetch(void* p) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return delivered_ < ready_.size() || error_; });
+    if (delivered_ == ready_.size()) {
+      std::rethrow_exception(error_);
+    }
+    deliver(p);
+  }
+
+  void complete() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.pop_front();
+      --delivered_;
+    }
+    changed_.notify_all();
+  }
+
+  void invalidatePrefetched() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    delivered_ = 0;
+  }
+
+private:
+  void deliver(void* p) {
+    std::memcpy(p, ready_[delivered_].bytes.data(), size_);
+    ++delivered_;
+  }
+
+  void loadAll() {
+    for (std::size_t i = 1; i < paths_.size(); ++i) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return stop_ || ready_.size() < loadAhead; });
+        if (stop_) {
+          return;
+        }
+      }
+
+      try {
+        BatchInput input = Load(load_, paths_[i]);
+        if (input.shape != shape_ || input.bytes.size() != size_) {
+          throw std::invalid_argument("The inputs of a batch must all be the same shape, " + paths_[i] +
+                                      " is not the same shape as " + paths_[0]);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(std::move(input));
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        error_ = std::current_exception();
+      }
+      changed_.notify_all();
+      if (error_) {
+        return;
+      }
+    }
+  }
+
+  const std::vector<std::string>& paths_;
+  std::vector<std::size_t> shape_;
+  std::size_t size_;
+  BatchLoad load_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<BatchInput> ready_;
+  std::size_t delivered_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+  std::thread loader_;
+};
+
+} // namespace
+
+bool UseBatch(const Options& options) {
+  if (!options.has("batch")) {
+    return false;
+  }
+  if (options.has("generate") || options.has("serve") || options.get("backend") == "host") {
+    throw std::invalid_argument("--batch streams its inputs to the device, so can't be used with --generate, --serve or the host backend");
+  }
+  return true;
+}
+
+std::vector<Program> PipelinePrograms(Graph& graph, const Tensor& input, const std::vector<Program>& programs) {
+  //
+  // The two buffers, spread over the I/O tiles after the compute tiles of graph, or
+  // mapped like the input when there are none
+  //
+  Graph& topLevel = graph.getTopLevelGraph();
+  unsigned firstIoTile = graph.getTarget().getNumTiles();
+  unsigned numTiles = topLevel.getTarget().getNumTiles();
+  Tensor buffers[2];
+  if (firstIoTile < numTiles) {
+    Graph ioGraph = topLevel.createVirtualGraph(firstIoTile, numTiles);
+    for (unsigned k = 0; k < 2; ++k) {
+      buffers[k] = ioGraph.addVariable(input.elementType(), {input.numElements()}, "batch/buffer" + std::to_string(k));
+      MapTensorBalanced(ioGraph, buffers[k]);
+    }
+  } else {
+    for (unsigned k = 0; k < 2; ++k) {
+      buffers[k] = graph.clone(input.flatten(), "batch/buffer" + std::to_string(k));
+    }
+  }
+  auto batchStream = graph.addHostToDeviceFIFO("batch", input.elementType(), input.numElements());
+
+  //
+  // The stream copy into the other buffer comes before the algorithm, so it is in
+  // flight on the I/O tiles while the compute tiles run
+  //
+  std::vector<Program> pipeline(NUM_PIPELINE_PROGRAMS);
+  pipeline[PIPELINE_FIRST] = Copy(batchStream, buffers[0]);
+  for (unsigned k = 0; k < 2; ++k) {
+    pipeline[PIPELINE_STEP + k] = Sequence({Copy(buffers[k], input.flatten()),
+                                            Copy(batchStream, buffers[1 - k]),
+                                            programs[ALGORITHM],
+                                            programs[COPY_OUT]});
+    pipeline[PIPELINE_LAST + k] = Sequence({Copy(buffers[k], input.flatten()),
+                                            programs[ALGORITHM],
+                                            programs[COPY_OUT]});
+  }
+  return pipeline;
+}
+
+int RunBatch(const Options& options, PhaseTimer& timer, const std::string& name, BatchBuild build, BatchLoad load,
+             BatchAnswer answer) {
+  //
+  // The first input gives the shape the programs are built for
+  //
+  timer.start("parse");
+  auto paths = ReadBatch(options.get("batch"));
+  BatchInput first = Load(load, paths[0]);
+  auto shape = first.shape;
+  timer.setParameter("mode", "batch");
+  timer.setParameter("batch", paths.size());
+  timer.setParameter("size", shape[0]);
+  std::cout << "Batch of " << paths.size() << " inputs" << std::endl;
+
+  timer.start("device");
+  IpuSession session(options);
+  timer.setSession(session);
+
+  //
+  // The day's programs are built on the compute tiles, the tiles before the I/O tiles
+  // that hold the input buffers (see PipelinePrograms)
+  //
+  timer.start("graph");
+  Graph& graph = session.getGraph();
+  const Target& target = graph.getTarget();
+  unsigned ioTiles = target.getNumIPUs() == 1 ? options.getUnsigned("io-tiles", 32) : 0;
+  if (ioTiles >= target.getNumTiles()) {
+    throw std::invalid_argument("--io-tiles=" + std::to_string(ioTiles) + " leaves no tiles to compute on");
+  }
+  timer.setParameter("io_tiles", ioTiles);
+  Graph computeGraph = graph.createVirtualGraph(0, target.getNumTiles() - ioTiles);
+  auto programs = build(computeGraph, shape);
+
+  timer.start("compile");
+  auto key = shape;
+  key.push_back(ioTiles);
+  Engine engine(CompileOrLoad(graph, programs, name + "_batch", key));
+  timer.start("load");
+  engine.load(session.getDevice());
+  timer.stop();
+
+  std::size_t bytesPerInput = first.bytes.size();
+  engine.connectStreamToCallback("batch", std::make_unique<BatchFeeder>(paths, std::move(first), load));
+  if (!answer) {
+    answer = [](const void* p) -> long long { return *static_cast<const int*>(p); };
+  }
+  std::vector<long long> results;
+  engine.connectStreamToCallback("result", [&](void* p) { results.push_back(answer(p)); });
+
+  //
+  // Each step computes one input while streaming the next, with the buffers taking
+  // turns
+  //
+  auto start = std::chrono::steady_clock::now();
+  timer.start("h2d");
+  engine.run(PIPELINE_FIRST);
+  for (std::size_t i = 0; i + 1 < paths.size(); ++i) {
+    timer.start("step");
+    engine.run(PIPELINE_STEP + i % 2);
+  }
+  timer.start("step");
+  engine.run(PIPELINE_LAST + (paths.size() - 1) % 2);
+  timer.stop();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (std::size_t i = 0; i < paths.size(); ++i) {
+    std::cout << paths[i] << " = " << results[i] << "\n";
+  }
+  std::cout << "Batch took " << seconds * 1000 << " ms, " << paths.size() / seconds << " inputs/s, "
+            << paths.size() * bytesPerInput / seconds / 1e6 << " MB/s in" << std::endl;
+  timer.report();
+  return 0;
+}
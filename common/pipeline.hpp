@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+#include <poplar/Tensor.hpp>
+
+#include <options.hpp>
+#include <phases.hpp>
+
+//
+// Pipelined batches, --batch=<file>.
+//
+// The file lists the inputs of a batch, one path per line, all of the same shape.
+// Rather than a separate copy in, run and copy out for each input, the inputs are
+// streamed through two buffers on the device in turn: while input k is computed from
+// one buffer, input k + 1 is streamed into the other.
+//
+// The buffers are on I/O tiles, the last --io-tiles (default 32) tiles of the IPU,
+// which the day's graph is not built on. So each step moves input k from its buffer
+// into the input tensor with an on-chip exchange, then issues the stream copy of input
+// k + 1, which only uses the I/O tiles, alongside the compute, which only uses the
+// others, so the two run at the same time. With more than one IPU, or --io-tiles=0,
+// the buffers go on the compute tiles and the transfer waits for the compute.
+//
+// On the host a loader thread parses the inputs ahead of the device, and the stream is
+// connected to a callback that prefetches the next parsed input while the device is
+// computing. So the parse, the transfer and the compute overlap, and the throughput
+// approaches the slowest of them rather than their sum.
+//
+
+//
+// True with --batch. The inputs come from the batch, so this throws
+// std::invalid_argument for --generate, --serve or the host backend.
+//
+bool UseBatch(const Options& options);
+
+//
+// The programs of a pipelined batch, for the input in buffer k = 0 or 1: FIRST streams
+// the first input into buffer 0, STEP + k moves buffer k into place, streams the next
+// input into the other buffer and runs the algorithm and copy out, and LAST + k does
+// the same for the final input without streaming another.
+//
+enum PipelineIndex { PIPELINE_FIRST = 0, PIPELINE_STEP = 1, PIPELINE_LAST = 3, NUM_PIPELINE_PROGRAMS = 5 };
+
+//
+// Turn a day's programs into the pipelined programs, with input the tensor that
+// COPY_IN copies to. The inputs are streamed from the "batch" stream. graph is the
+// compute tiles RunBatch gave the build, the buffers go on the tiles after them.
+//
+std::vector<poplar::program::Program> PipelinePrograms(poplar::Graph& graph, const poplar::Tensor& input,
+                                                       const std::vector<poplar::program::Program>& programs);
+
+//
+// One parsed input of a batch, the bytes streamed to the input tensor and the shape
+// the programs were built for
+//
+struct BatchInput {
+  std::vector<std::size_t> shape;
+  std::vector<char> bytes;
+};
+
+template <typename T>
+BatchInput MakeBatchInput(std::vector<std::size_t> shape, const std::vector<T>& values) {
+  BatchInput input{std::move(shape), std::vector<char>(values.size() * sizeof(T))};
+  if (!values.empty()) {
+    std::memcpy(input.bytes.data(), values.data(), input.bytes.size());
+  }
+  return input;
+}
+
+//
+// Run the batch. build builds the day's programs for a shape of input (and so calls
+// PipelinePrograms), load parses one input of the batch, and answer gives the answer
+// from what an input copied out, by default a single INT. The result of each input is
+// printed, with the throughput of the whole batch.
+//
+using BatchBuild = std::function<std::vector<poplar::program::Program>(poplar::Graph& graph, const std::vector<std::size_t>& shape)>;
+using BatchLoad = std::function<BatchInput(std::string_view input)>;
+using BatchAnswer = std::function<long long(const void* result)>;
+int RunBatch(const Options& options, PhaseTimer& timer, const std::string& name, BatchBuild build, BatchLoad load,
+             BatchAnswer answer = nullptr);
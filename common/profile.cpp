@@ -0,0 +1,99 @@
+#include <profile.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <pva/pva.hpp>
+
+Profiler::Profiler(const Options& options)
+  : enabled_(options.has("profile")),
+    directory_(options.get("profile-dir", ".")),
+    top_(options.getUnsigned("profile-top", 20)) {
+  if (enabled_) {
+    engineOptions_.set("autoReport.all", "true");
+    engineOptions_.set("autoReport.directory", directory_);
+  }
+}
+
+Profiler::~Profiler() {
+  if (!enabled_) {
+    return;
+  }
+  try {
+    PrintSummary(directory_ + "/profile.pop", top_);
+  } catch (const std::exception& e) {
+    std::cerr << "Could not read the profile in " << directory_ << ": " << e.what() << "\n";
+  }
+}
+
+void Profiler::PrintSummary(const std::string& reportPath, unsigned top) {
+  pva::Report report = pva::openReport(reportPath);
+  auto compilation = report.compilation();
+  std::cout << "\nProfile " << reportPath << "\n";
+
+  //
+  // Graph size
+  //
+  auto graph = compilation.graph();
+  std::cout << "  Graph: " << graph.numVertices() << " vertices, " << graph.numEdges() << " edges, "
+            << graph.numComputeSets() << " compute sets, " << graph.numVariables() << " variables\n";
+
+  //
+  // Tile memory, including the gaps between variables as that is what limits what fits
+  //
+  std::uint64_t peakMemory = 0;
+  std::uint64_t totalMemory = 0;
+  unsigned peakTile = 0;
+  auto tiles = compilation.tiles();
+  for (const auto& tile : tiles) {
+    std::uint64_t bytes = tile.memory().total().includingGaps();
+    totalMemory += bytes;
+    if (bytes > peakMemory) {
+      peakMemory = bytes;
+      peakTile = tile.number();
+    }
+  }
+  std::cout << "  Memory: peak " << peakMemory << " bytes on tile " << peakTile << " of "
+            << compilation.target().bytesPerTile() << ", total " << totalMemory
+            << " bytes over " << tiles.size() << " tiles\n";
+
+  //
+  // Cycles per program step, summed over every time the step ran. With more than one
+  // IPU the IPUs run a step together, so a step takes as long as the slowest IPU.
+  //
+  struct StepCycles {
+    std::uint64_t cycles = 0;
+    std::uint64_t count = 0;
+  };
+  std::map<std::string, StepCycles> steps;
+  std::uint64_t totalCycles = 0;
+  for (const auto& step : report.execution().steps()) {
+    std::uint64_t cycles = 0;
+    for (const auto& ipu : step.ipus()) {
+      cycles = std::max<std::uint64_t>(cycles, ipu.cycles());
+    }
+    auto& entry = steps[step.program()->name()];
+    entry.cycles += cycles;
+    entry.count += 1;
+    totalCycles += cycles;
+  }
+
+  std::vector<std::pair<std::string, StepCycles>> sorted(steps.begin(), steps.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+    return a.second.cycles > b.second.cycles;
+  });
+
+  std::cout << "  Cycles: " << totalCycles << " in " << steps.size() << " program steps\n";
+  std::cout << "    " << std::setw(12) << "cycles" << std::setw(8) << "%" << std::setw(8) << "runs" << "  step\n";
+  for (std::size_t i = 0; i < sorted.size() && i < top; ++i) {
+    const auto& step = sorted[i];
+    double percent = totalCycles == 0 ? 0 : 100.0 * step.second.cycles / totalCycles;
+    std::cout << "    " << std::setw(12) << step.second.cycles
+              << std::setw(8) << std::fixed << std::setprecision(1) << percent << std::defaultfloat
+              << std::setw(8) << step.second.count << "  " << step.first << "\n";
+  }
+  if (sorted.size() > top) {
+    std::cout << "    ... " << sorted.size() - top << " more (--profile-top)\n";
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <poplar/OptionFlags.hpp>
+
+#include <options.hpp>
+
+//
+// Profiling with --profile.
+//
+// Turns on the engine's profiling (the same as autoReport.all) for the compile and the
+// run, writing profile.pop to --profile-dir (default the day's directory) for the
+// PopVision Graph Analyser. The report is also read back with libpva and summarised:
+//   - the graph size, i.e. the number of vertices, edges and compute sets
+//   - the peak and total tile memory
+//   - the cycles of each program step (compute sets, exchanges, copies...) summed over
+//     every time it ran, the most expensive first (--profile-top, default 20)
+//
+// The execution profile is only complete once the engine is destroyed, so the summary
+// is printed when the Profiler is destroyed. Declare it before the Engine so it is
+// destroyed after it.
+//
+class Profiler {
+public:
+  explicit Profiler(const Options& options);
+  ~Profiler();
+
+  bool enabled() const { return enabled_; }
+
+  //
+  // Options to pass to both the compile and the Engine, empty when not profiling
+  //
+  const poplar::OptionFlags& engineOptions() const { return engineOptions_; }
+
+  //
+  // Print the summary of a profile
+  //
+  static void PrintSummary(const std::string& reportPath, unsigned top);
+
+private:
+  bool enabled_;
+  std::string directory_;
+  unsigned top_;
+  poplar::OptionFlags engineOptions_;
+};
@@ -0,0 +1,71 @@
+#include <scan.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <poputil/VertexTemplates.hpp>
+
+#include <vertices.hpp>
+
+using namespace poplar;
+using namespace poplar::program;
+
+Tensor PrefixSum(Graph& graph, const Tensor& input, ScanType type,
+                 Sequence& prog, const std::string& debugName) {
+  if (input.elementType() != INT || input.rank() != 1) {
+    throw std::invalid_argument(debugName + ": PrefixSum needs a 1-D INT tensor");
+  }
+
+  Tensor output = graph.clone(input, debugName + "/Output");
+
+  //
+  // The carries run from the first element to the last so the regions must be in
+  // the order they appear in the tensor, not the order of the tiles
+  //
+  auto regions = SplitOverWorkers(graph, input);
+  std::sort(regions.begin(), regions.end(), [](const WorkerRegion& a, const WorkerRegion& b) {
+    return a.begin < b.begin;
+  });
+
+  //
+  // Scan each region
+  //
+  ComputeSet scanCs = graph.addComputeSet(debugName + "/ScanRegions");
+  Tensor totals = graph.addVariable(INT, {regions.size()}, debugName + "/Totals");
+  std::string scanVertex = poputil::templateVertex("ScanRegion", type == ScanType::Exclusive);
+  for (std::size_t i = 0; i < regions.size(); ++i) {
+    const auto& region = regions[i];
+    auto v = graph.addVertex(scanCs, scanVertex, {{"in", input.slice(region.begin, region.end)},
+                                                  {"out", output.slice(region.begin, region.end)},
+                                                  {"total", totals[i]}});
+    graph.setTileMapping(v, region.tile);
+    graph.setTileMapping(totals[i], region.tile);
+    graph.setPerfEstimate(v, 10 + (region.end - region.begin) * 3);
+  }
+  prog.add(Execute(scanCs));
+
+  //
+  // Scan the totals, this is one value per worker so fits easily on one tile
+  //
+  ComputeSet carryCs = graph.addComputeSet(debugName + "/ScanCarries");
+  Tensor carries = graph.addVariable(INT, {regions.size()}, debugName + "/Carries");
+  graph.setTileMapping(carries, 0);
+  auto carryVertex = graph.addVertex(carryCs, "ScanCarries", {{"totals", totals}, {"carries", carries}});
+  graph.setTileMapping(carryVertex, 0);
+  graph.setPerfEstimate(carryVertex, 10 + regions.size() * 3);
+  prog.add(Execute(carryCs));
+
+  //
+  // Add the carries back into the regions, the first region has nothing to add
+  //
+  ComputeSet addCs = graph.addComputeSet(debugName + "/AddCarries");
+  for (std::size_t i = 1; i < regions.size(); ++i) {
+    const auto& region = regions[i];
+    auto v = graph.addVertex(addCs, "ScanAddCarry", {{"data", output.slice(region.begin, region.end)},
+                                                     {"carry", carries[i]}});
+    graph.setTileMapping(v, region.tile);
+    graph.setPerfEstimate(v, 10 + (region.end - region.begin) * 2);
+  }
+  prog.add(Execute(addCs));
+
+  return output;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+#include <poplar/Tensor.hpp>
+
+enum class ScanType {
+  Inclusive, // out[i] = in[0] + ... + in[i]
+  Exclusive, // out[i] = in[0] + ... + in[i - 1], so out[0] = 0
+};
+
+//
+// Parallel prefix sum of a 1-D tensor. The sums are written to a new tensor with the
+// same tile mapping as the input, which is returned; the input is left unchanged.
+// Only INT is supported (the vertices are not templated on the type), anything else
+// throws std::invalid_argument.
+//
+// Done in three steps:
+//   1. each worker scans its own region of the input into the same region of the
+//      result on its tile and writes the total of the region
+//   2. the region totals are gathered onto one tile and scanned to give the carry
+//      into each region
+//   3. each worker adds the carry into its region to its part of the result
+//
+// Needs the common codelets (AddCommonCodelets).
+//
+poplar::Tensor PrefixSum(poplar::Graph& graph, const poplar::Tensor& input, ScanType type,
+                         poplar::program::Sequence& prog, const std::string& debugName);
@@ -0,0 +1,289 @@
+#include <serve.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cache.hpp>
+#include <input.hpp>
+
+using namespace poplar;
+using namespace poplar::program;
+
+namespace {
+
+//
+// Reads the requests a line at a time from a file descriptor and writes the answers
+// back, to stdin/stdout or to a socket connection
+//
+class Connection {
+public:
+  Connection(int in, int out, bool socket) : in_(in), out_(out), socket_(socket) {}
+
+  //
+  // The next line without its '\n', false at the end of the input
+  //
+  bool readLine(std::string& line) {
+    while (true) {
+      auto newline = buffer_.find('\n');
+      if (newline != std::string::npos) {
+        line = buffer_.substr(0, newline);
+        buffer_.erase(0, newline + 1);
+        if (!line.empty() && line.back() == '\r') {
+          line.pop_back();
+        }
+        return true;
+      }
+
+      char chunk[1 << 16];
+      ssize_t n = ::read(in_, chunk, sizeof(chunk));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        // A last line without a '\n'
+        if (buffer_.empty()) {
+          return false;
+        }
+        line.swap(buffer_);
+        buffer_.clear();
+        return true;
+      }
+      buffer_.append(chunk, n);
+    }
+  }
+
+  //
+  // Write a line, a client that has gone away is not an error for the server
+  //
+  void writeLine(const std::string& text) {
+    std::string line = text + "\n";
+    std::size_t written = 0;
+    while (written < line.size()) {
+      ssize_t n = socket_ ? ::send(out_, line.data() + written, line.size() - written, MSG_NOSIGNAL)
+                          : ::write(out_, line.data() + written, line.size() - written);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        return;
+      }
+      written += n;
+    }
+  }
+
+private:
+  int in_;
+  int out_;
+  bool socket_;
+  std::string buffer_;
+};
+
+enum class Status { NEXT, QUIT };
+
+//
+// Answer the requests on one connection, returns QUIT when asked to stop the server
+//
+Status Answer(Connection& connection, PhaseTimer& timer, EngineCache& engines, const Solve& solve) {
+  std::string line;
+  while (connection.readLine(line)) {
+    std::istringstream request(line);
+    std::string command;
+    request >> command;
+    if (command.empty()) {
+      continue;
+    }
+    if (command == "quit") {
+      return Status::QUIT;
+    }
+
+    timer.start("request");
+    try {
+      long long result;
+      if (command == "file") {
+        std::string path;
+        request >> path;
+        MappedFile data(path);
+        result = solve(engines, data.contents());
+      } else if (command == "data") {
+        std::size_t numLines = 0;
+        request >> numLines;
+        std::string input, inputLine;
+        for (std::size_t i = 0; i < numLines && connection.readLine(inputLine); ++i) {
+          input += inputLine;
+          input += '\n';
+        }
+        result = solve(engines, input);
+      } else {
+        throw std::invalid_argument("Unknown request " + command + ", expected file, data or quit");
+      }
+      double ms = timer.stop();
+      connection.writeLine("ok " + std::to_string(result) + " " + std::to_string(ms));
+    } catch (const std::exception& e) {
+      timer.stop();
+      connection.writeLine(std::string("error ") + e.what());
+    }
+  }
+  return Status::NEXT;
+}
+
+//
+// Listen on a Unix socket at path, replacing any stale socket left there. Throws
+// std::system_error if it can't.
+//
+int Listen(const std::string& path) {
+  sockaddr_un address{};
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::invalid_argument("Socket path " + path + " is too long");
+  }
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(path.c_str());
+  if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 4) != 0) {
+    int error = errno;
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    throw std::system_error(error, std::generic_category(), "Could not listen on " + path);
+  }
+  return fd;
+}
+
+} // namespace
+
+bool UseServer(const Options& options) {
+  if (!options.has("serve")) {
+    return false;
+  }
+  if (options.has("generate") || options.get("backend") == "host") {
+    throw std::invalid_argument("--serve answers jobs with their own input on the device, so can't be used with --generate or the host backend");
+  }
+  return true;
+}
+
+std::size_t BucketSize(std::size_t size) {
+  std::size_t bucket = 1;
+  while (bucket < size) {
+    bucket *= 2;
+  }
+  return bucket;
+}
+
+EngineCache::EngineCache(IpuSession& session, const std::string& name, Build build, std::size_t maxEngines)
+  : session_(session), name_(name), build_(std::move(build)), maxEngines_(std::max<std::size_t>(1, maxEngines)) {}
+
+Engine& EngineCache::get(const std::vector<std::size_t>& shape) {
+  auto found = engines_.find(shape);
+  if (found == engines_.end()) {
+    Graph graph = session_.createGraph();
+    auto programs = build_(graph, shape);
+    auto engine = std::make_unique<Engine>(CompileOrLoad(graph, programs, name_, shape));
+
+    //
+    // Make room by dropping the engine used least recently
+    //
+    if (engines_.size() >= maxEngines_) {
+      auto oldest = std::min_element(engines_.begin(), engines_.end(), [](const auto& a, const auto& b) {
+        return a.second.lastUsed < b.second.lastUsed;
+      });
+      if (oldest->second.engine.get() == loaded_) {
+        loaded_ = nullptr;
+      }
+      engines_.erase(oldest);
+    }
+    found = engines_.emplace(shape, Entry{std::move(engine), 0}).first;
+  }
+  found->second.lastUsed = ++uses_;
+
+  Engine& engine = *found->second.engine;
+  if (loaded_ != &engine) {
+    engine.load(session_.getDevice());
+    loaded_ = &engine;
+  }
+  return engine;
+}
+
+int RunJob(Engine& engine, void* data) {
+  int result = 0;
+  RunJob(engine, data, &result);
+  return result;
+}
+
+void RunJob(Engine& engine, void* data, void* result) {
+  engine.connectStream("data", data);
+  engine.connectStream("result", result);
+  engine.run(COPY_IN);
+  engine.run(ALGORITHM);
+  engine.run(COPY_OUT);
+}
+
+int Serve(const Options& options, PhaseTimer& timer, const std::string& name, EngineCache::Build build, Solve solve) {
+  //
+  // Serving stdin keeps stdout for the answers
+  //
+  std::string socketPath = options.get("socket");
+  auto* coutBuffer = std::cout.rdbuf();
+  if (socketPath.empty()) {
+    std::cout.rdbuf(std::cerr.rdbuf());
+  }
+
+  //
+  // A device that can't be created fails the server. When serving stdin the client is
+  // told with an error answer, then the error goes on to main like any other.
+  //
+  timer.start("device");
+  std::optional<IpuSession> session;
+  try {
+    session.emplace(options);
+  } catch (const DeviceError& e) {
+    if (socketPath.empty()) {
+      Connection(STDIN_FILENO, STDOUT_FILENO, false).writeLine(std::string("error ") + e.what());
+      std::cout.rdbuf(coutBuffer);
+    }
+    throw;
+  }
+  timer.setSession(*session);
+  timer.setParameter("mode", "serve");
+  timer.stop();
+  EngineCache engines(*session, name, std::move(build), options.getUnsigned("engines", 8));
+
+  if (socketPath.empty()) {
+    Connection connection(STDIN_FILENO, STDOUT_FILENO, false);
+    Answer(connection, timer, engines, solve);
+    std::cout.rdbuf(coutBuffer);
+    timer.report();
+    return 0;
+  }
+
+  int listener = Listen(socketPath);
+  std::cout << "Serving on " << socketPath << std::endl;
+  Status status = Status::NEXT;
+  while (status != Status::QUIT) {
+    int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Could not accept a connection: " << std::strerror(errno) << "\n";
+      break;
+    }
+    Connection connection(fd, fd, true);
+    status = Answer(connection, timer, engines, solve);
+    ::close(fd);
+  }
+  ::close(listener);
+  ::unlink(socketPath.c_str());
+  timer.report();
+  return 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <poplar/Engine.hpp>
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+
+#include <common.hpp>
+#include <options.hpp>
+#include <phases.hpp>
+
+//
+// Service mode, --serve.
+//
+// Rather than attaching, compiling, loading and running once for a single input, a
+// day started with --serve attaches to the device once and then answers jobs until
+// it is told to quit, keeping an engine for each shape of input it has seen. So after
+// the first job of a shape a request only pays for its parse, copies and run.
+//
+// The inputs are padded up to the next power of two in length (BucketSize) with
+// values that leave the answer unchanged, so jobs of similar lengths share an engine
+// rather than compiling one for every length. At most --engines (default 8) engines
+// are kept, dropping the one used least recently.
+//
+// Jobs are read from stdin, or from connections to a Unix socket with --socket=<path>
+// (one connection at a time, as there is one device). One request per line:
+//
+//   file <path>    the input is in a file
+//   data <lines>   the input follows inline, in the next <lines> lines
+//   quit           stop the server
+//
+// Each is answered with a line "ok <result> <ms>", with the latency of the request,
+// or "error <message>". When serving stdin the day's own output goes to stderr, so
+// stdout only has the answers.
+//
+
+//
+// True with --serve. The jobs bring their own input, so this throws
+// std::invalid_argument for --generate or the host backend.
+//
+bool UseServer(const Options& options);
+
+//
+// The size an input of size elements is padded up to for the server, the next power
+// of two
+//
+std::size_t BucketSize(std::size_t size);
+
+//
+// The engines for each shape of input, compiled (or loaded from the executable cache)
+// on the first job of that shape and kept until maxEngines others have been used more
+// recently. Each shape gets its own graph, built by the day's build function.
+//
+class EngineCache {
+public:
+  using Build = std::function<std::vector<poplar::program::Program>(poplar::Graph& graph, const std::vector<std::size_t>& shape)>;
+
+  EngineCache(IpuSession& session, const std::string& name, Build build, std::size_t maxEngines);
+
+  //
+  // The engine for the shape, loaded onto the device. Only one executable can be
+  // loaded at a time, so switching shape reloads the device (but does not compile).
+  //
+  poplar::Engine& get(const std::vector<std::size_t>& shape);
+
+private:
+  IpuSession& session_;
+  std::string name_;
+  Build build_;
+  std::size_t maxEngines_;
+
+  struct Entry {
+    std::unique_ptr<poplar::Engine> engine;
+    std::size_t lastUsed;
+  };
+  std::map<std::vector<std::size_t>, Entry> engines_;
+  std::size_t uses_ = 0;
+  poplar::Engine* loaded_ = nullptr;
+};
+
+//
+// Copy the input in from data, run the algorithm and copy the result out, i.e. the
+// COPY_IN, ALGORITHM and COPY_OUT programs with the "data" and "result" streams. The
+// first returns a result of a single INT, the second copies it to result.
+//
+int RunJob(poplar::Engine& engine, void* data);
+void RunJob(poplar::Engine& engine, void* data, void* result);
+
+//
+// Attach to the device and answer jobs until quit (or the end of stdin). build builds
+// the day's programs for a shape of input, and solve is given the engines and the
+// contents of a job's input and returns the answer. solve can throw to fail the job.
+// Each request is timed as the "request" phase, and the timings are reported when the
+// server stops. A device that can't be created throws the DeviceError, after answering
+// it with an error when serving stdin, and a socket that can't be listened on throws
+// std::system_error.
+//
+using Solve = std::function<long long(EngineCache& engines, std::string_view input)>;
+int Serve(const Options& options, PhaseTimer& timer, const std::string& name, EngineCache::Build build, Solve solve);
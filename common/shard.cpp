@@ -0,0 +1,100 @@
+#include <shard.hpp>
+#include <vector>
+#include <popops/Reduce.hpp>
+
+using namespace poplar;
+using namespace poplar::program;
+
+namespace {
+
+std::size_t ShardSize(const Tensor& tensor, unsigned numShards) {
+  return (tensor.dim(0) + numShards - 1) / numShards;
+}
+
+} // namespace
+
+unsigned NumShards(const Graph& graph) {
+  return graph.getTarget().getNumIPUs();
+}
+
+void MapSharded(Graph& graph, const Tensor& tensor) {
+  unsigned numShards = NumShards(graph);
+  unsigned tilesPerIPU = graph.getTarget().getTilesPerIPU();
+  std::size_t shardSize = ShardSize(tensor, numShards);
+
+  for (unsigned shard = 0; shard < numShards; ++shard) {
+    std::size_t begin = std::min(shard * shardSize, tensor.dim(0));
+    std::size_t end = std::min(begin + shardSize, tensor.dim(0));
+    if (begin == end) {
+      break;
+    }
+
+    Graph ipuGraph = graph.createVirtualGraph(shard * tilesPerIPU, (shard + 1) * tilesPerIPU);
+    MapTensorBalanced(ipuGraph, tensor.slice(begin, end, 0));
+  }
+}
+
+Tensor ShardedSum(Graph& graph, const Tensor& tensor, const Type& type,
+                  Sequence& prog, const std::string& debugName) {
+  unsigned numShards = NumShards(graph);
+  if (numShards == 1 || tensor.dim(0) == 0) {
+    return popops::reduce(graph, tensor, type, {0}, {popops::Operation::ADD}, prog, debugName);
+  }
+
+  //
+  // Find the IPU each row (element of dimension 0) is on, from the tile of its first
+  // element. The rows of a tensor mapped with MapSharded, or of partial results made
+  // where the tiles of a sharded tensor are, are in a contiguous run on each IPU.
+  //
+  unsigned tilesPerIPU = graph.getTarget().getTilesPerIPU();
+  std::size_t numRows = tensor.dim(0);
+  std::size_t rowSize = tensor.numElements() / numRows;
+  std::vector<unsigned> rowShard(numRows, 0);
+  auto mapping = graph.getTileMapping(tensor);
+  for (unsigned tile = 0; tile < mapping.size(); ++tile) {
+    for (const auto& interval : mapping[tile]) {
+      for (std::size_t row = (interval.begin() + rowSize - 1) / rowSize; row * rowSize < interval.end(); ++row) {
+        rowShard[row] = tile / tilesPerIPU;
+      }
+    }
+  }
+
+  //
+  // Each IPU sums its own rows, with the partial total kept on that IPU. The sums share
+  // their compute sets so the IPUs all work at the same time.
+  //
+  auto partialShape = tensor.shape();
+  partialShape.erase(partialShape.begin());
+  std::vector<ComputeSet> computeSets;
+  std::vector<Tensor> partials;
+  for (unsigned shard = 0; shard < numShards; ++shard) {
+    std::vector<Tensor> rows;
+    for (std::size_t begin = 0; begin < numRows;) {
+      std::size_t end = begin + 1;
+      while (end < numRows && rowShard[end] == rowShard[begin]) {
+        ++end;
+      }
+      if (rowShard[begin] == shard) {
+        rows.push_back(tensor.slice(begin, end, 0));
+      }
+      begin = end;
+    }
+    if (rows.empty()) {
+      continue;
+    }
+
+    Tensor partial = graph.addVariable(type, partialShape, debugName + "/Partial");
+    graph.setTileMapping(partial, shard * tilesPerIPU);
+    popops::reduceWithOutput(graph, concat(rows, 0), partial, {0}, {popops::Operation::ADD}, computeSets,
+                             debugName + "/PerIPU");
+    partials.push_back(partial.expand({0}));
+  }
+  for (const auto& cs : computeSets) {
+    prog.add(Execute(cs));
+  }
+
+  //
+  // Then combine the per-IPU totals
+  //
+  return popops::reduce(graph, concat(partials, 0), type, {0}, {popops::Operation::ADD}, prog, debugName + "/AcrossIPUs");
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+#include <poplar/Tensor.hpp>
+
+#include <mapping.hpp>
+
+//
+// Sharding over multiple IPUs.
+//
+// The first dimension of a tensor is split into one contiguous block per IPU of the
+// target (--ipus=N). Operations on the whole tensor then run on all the IPUs at the
+// same time, and sums along the first dimension are done on each IPU before only the
+// per-IPU totals are exchanged between the IPUs.
+//
+// With a single IPU these are the same as MapTensorBalanced and popops::reduce.
+//
+unsigned NumShards(const poplar::Graph& graph);
+
+//
+// Map each IPU's block over that IPU's tiles
+//
+void MapSharded(poplar::Graph& graph, const poplar::Tensor& tensor);
+
+//
+// Sum along dimension 0 of a tensor, i.e. the same as popops::reduce(graph, tensor,
+// type, {0}, ADD, ...). Each IPU sums the rows mapped to it, as for a tensor mapped
+// with MapSharded or the per-worker partials of a vertex run over one.
+//
+poplar::Tensor ShardedSum(poplar::Graph& graph, const poplar::Tensor& tensor, const poplar::Type& type,
+                          poplar::program::Sequence& prog, const std::string& debugName);
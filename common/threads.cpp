@@ -0,0 +1,62 @@
+#include <threads.hpp>
+
+ThreadPool::ThreadPool(unsigned numThreads) {
+  for (unsigned i = 1; i < numThreads; ++i) {
+    threads_.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::run(std::size_t n, const std::function<void(std::size_t)>& task) {
+  if (n == 0) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &task;
+  next_ = 0;
+  count_ = n;
+  remaining_ = n;
+  ++generation_;
+  wake_.notify_all();
+
+  // Work on the tasks too, then wait for any still running on the pool
+  runTasks(lock);
+  done_.wait(lock, [this] { return remaining_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::work() {
+  std::uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+    if (stop_) {
+      return;
+    }
+    seen = generation_;
+    runTasks(lock);
+  }
+}
+
+void ThreadPool::runTasks(std::unique_lock<std::mutex>& lock) {
+  while (next_ < count_) {
+    std::size_t index = next_++;
+    lock.unlock();
+    (*task_)(index);
+    lock.lock();
+    if (--remaining_ == 0) {
+      done_.notify_all();
+    }
+  }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// A fixed pool of threads for the host backend.
+//
+// run(n, task) calls task(0) ... task(n - 1) spread over the pool and the calling
+// thread, and returns once they have all finished. So a pool of numThreads uses
+// numThreads - 1 extra threads.
+//
+class ThreadPool {
+public:
+  explicit ThreadPool(unsigned numThreads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  unsigned size() const { return threads_.size() + 1; }
+
+  void run(std::size_t n, const std::function<void(std::size_t)>& task);
+
+private:
+  void work();
+  void runTasks(std::unique_lock<std::mutex>& lock);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void(std::size_t)>* task_ = nullptr;
+  std::size_t next_ = 0;
+  std::size_t count_ = 0;
+  std::size_t remaining_ = 0;
+  std::uint64_t generation_ = 0;
+  bool stop_ = false;
+};
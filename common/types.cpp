@@ -0,0 +1,106 @@
+#include <types.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+using namespace poplar;
+
+namespace {
+
+//
+// The types a tensor can be narrowed to, indexed by TypeId
+//
+const Type narrowTypes[] = {UNSIGNED_CHAR, SHORT, UNSIGNED_SHORT, INT, UNSIGNED_INT};
+
+template <typename To, typename From>
+std::vector<char> Convert(const std::vector<From>& values) {
+  std::vector<char> bytes(values.size() * sizeof(To));
+  To* out = reinterpret_cast<To*>(bytes.data());
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    out[i] = static_cast<To>(values[i]);
+  }
+  return bytes;
+}
+
+template <typename From>
+std::vector<char> ConvertTo(const std::vector<From>& values, const Type& type) {
+  if (type == UNSIGNED_CHAR) {
+    return Convert<unsigned char>(values);
+  } else if (type == SHORT) {
+    return Convert<short>(values);
+  } else if (type == UNSIGNED_SHORT) {
+    return Convert<unsigned short>(values);
+  } else if (type == INT) {
+    return Convert<int>(values);
+  } else if (type == UNSIGNED_INT) {
+    return Convert<unsigned>(values);
+  }
+  throw std::invalid_argument("Can't stream values as " + type.toString());
+}
+
+} // namespace
+
+bool UseNarrowTypes(const Options& options) {
+  std::string types = options.get("types", "auto");
+  if (types != "auto" && types != "int") {
+    throw std::invalid_argument("Unknown --types=" + types + ", expected auto or int");
+  }
+  return types == "auto" && !options.has("generate") && !options.has("batch");
+}
+
+Type NarrowestType(long long min, long long max) {
+  if (min >= 0 && max <= UCHAR_MAX) {
+    return UNSIGNED_CHAR;
+  }
+  if (min >= SHRT_MIN && max <= SHRT_MAX) {
+    return SHORT;
+  }
+  return INT;
+}
+
+Type NarrowestUnsignedType(unsigned numBits) {
+  if (numBits <= 8) {
+    return UNSIGNED_CHAR;
+  }
+  if (numBits <= 16) {
+    return UNSIGNED_SHORT;
+  }
+  return UNSIGNED_INT;
+}
+
+Type InputType(const Options& options, const std::vector<int>& values) {
+  if (!UseNarrowTypes(options) || values.empty()) {
+    return INT;
+  }
+  auto [min, max] = std::minmax_element(values.begin(), values.end());
+  return NarrowestType(*min, *max);
+}
+
+Type RowType(const Options& options, unsigned numBits) {
+  return UseNarrowTypes(options) ? NarrowestUnsignedType(numBits) : UNSIGNED_INT;
+}
+
+std::size_t TypeId(const Type& type) {
+  auto found = std::find(std::begin(narrowTypes), std::end(narrowTypes), type);
+  if (found == std::end(narrowTypes)) {
+    throw std::invalid_argument("No id for the type " + type.toString());
+  }
+  return found - std::begin(narrowTypes);
+}
+
+Type TypeFromId(std::size_t id) {
+  if (id >= std::size(narrowTypes)) {
+    throw std::invalid_argument("No type with id " + std::to_string(id));
+  }
+  return narrowTypes[id];
+}
+
+std::vector<char> NarrowValues(const std::vector<int>& values, const Type& type) {
+  return ConvertTo(values, type);
+}
+
+std::vector<char> NarrowValues(const std::vector<unsigned>& values, const Type& type) {
+  return ConvertTo(values, type);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <poplar/Type.hpp>
+
+#include <options.hpp>
+
+//
+// Narrow device types, chosen from the range of the parsed input.
+//
+// The values a day copies to the device need far fewer than 32 bits for real inputs:
+// the depths are below 2^15, a packed command below 2^8 and a row of day 3 is 12 bits.
+// So the input tensor is created with the narrowest type that holds the range of the
+// input, which cuts its tile memory, its exchange and the host-to-device copy by 2-4x.
+// The vertices read the narrow elements and accumulate in 32 bits, and the
+// intermediates that need the wider range (the aim of day 2 part 2) are widened with a
+// cast where they are computed.
+//
+// --types=int keeps the 32-bit types. Generated inputs and batches also keep them, as
+// the range is only known once the input has been generated on the device, or once
+// every input of the batch has been parsed. So do the chunks streamed by day 1 part 1
+// and the rows of day 3 part 2, which are sorted on 32-bit keys.
+//
+bool UseNarrowTypes(const Options& options);
+
+//
+// The narrowest of UNSIGNED_CHAR, SHORT and INT that holds every value in [min, max]
+//
+poplar::Type NarrowestType(long long min, long long max);
+
+//
+// The narrowest of UNSIGNED_CHAR, UNSIGNED_SHORT and UNSIGNED_INT with numBits bits
+//
+poplar::Type NarrowestUnsignedType(unsigned numBits);
+
+//
+// The type for the input tensor holding values, or INT without UseNarrowTypes
+//
+poplar::Type InputType(const Options& options, const std::vector<int>& values);
+
+//
+// The type for day 3 rows packed into numBits bits, or UNSIGNED_INT without
+// UseNarrowTypes
+//
+poplar::Type RowType(const Options& options, unsigned numBits);
+
+//
+// The types are part of the shapes given to the executable cache and the server, so
+// they are passed as an index. Both throw std::invalid_argument for a type that is
+// not one of the narrow types.
+//
+std::size_t TypeId(const poplar::Type& type);
+poplar::Type TypeFromId(std::size_t id);
+
+//
+// The values converted to type, as the bytes to stream to a tensor of that type
+//
+std::vector<char> NarrowValues(const std::vector<int>& values, const poplar::Type& type);
+std::vector<char> NarrowValues(const std::vector<unsigned>& values, const poplar::Type& type);
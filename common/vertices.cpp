@@ -0,0 +1,236 @@
+#include <vertices.hpp>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <popops/Reduce.hpp>
+#include <poputil/VertexTemplates.hpp>
+
+#include <input.hpp>
+#include <shard.hpp>
+
+using namespace poplar;
+using namespace poplar::program;
+
+namespace {
+
+//
+// Don't split the work on a tile into pieces smaller than this
+//
+const std::size_t minElementsPerWorker = 64;
+
+//
+// The codelets live next to this file. The root Makefile passes their absolute path,
+// so the days can be run from anywhere.
+//
+std::string CodeletsDirectory() {
+#ifdef AOC_CODELETS_DIR
+  return AOC_CODELETS_DIR;
+#else
+  std::string file = __FILE__;
+  return file.substr(0, file.find_last_of('/') + 1) + "codelets/";
+#endif
+}
+
+} // namespace
+
+std::vector<WorkerRegion> SplitOverWorkers(const Graph& graph, const Tensor& tensor) {
+  const unsigned numWorkers = graph.getTarget().getNumWorkerContexts();
+  std::vector<WorkerRegion> regions;
+  auto mapping = graph.getTileMapping(tensor);
+  for (unsigned tile = 0; tile < mapping.size(); ++tile) {
+    for (const auto& interval : mapping[tile]) {
+      std::size_t size = interval.size();
+      std::size_t perWorker = std::max(minElementsPerWorker, (size + numWorkers - 1) / numWorkers);
+      for (std::size_t begin = interval.begin(); begin < interval.end(); begin += perWorker) {
+        regions.push_back({tile, begin, std::min<std::size_t>(begin + perWorker, interval.end())});
+      }
+    }
+  }
+  return regions;
+}
+
+//
+// Load the codelets compiled ahead of time by popc (see the root Makefile), falling
+// back to compiling the source, which adds several seconds to every run
+//
+void AddCommonCodelets(Graph& graph) {
+  std::string precompiled = CodeletsDirectory() + "codelets.gp";
+  if (std::ifstream(precompiled).good()) {
+    graph.addCodelets(precompiled);
+  } else {
+    graph.addCodelets(CodeletsDirectory() + "codelets.cpp", "-O3");
+  }
+}
+
+Tensor CountIncreases(Graph& graph, const Tensor& values, const Tensor& previous,
+                      Sequence& prog, const std::string& debugName) {
+  auto regions = SplitOverWorkers(graph, values);
+
+  // The vertex for the type of the values
+  std::string vertexName = poputil::templateVertex("CountIncreases", values.elementType());
+
+  ComputeSet cs = graph.addComputeSet(debugName);
+  Tensor partials = graph.addVariable(INT, {regions.size()}, debugName + "/Partials");
+  for (std::size_t i = 0; i < regions.size(); ++i) {
+    const auto& region = regions[i];
+
+    //
+    // Compare the first value with the last value of the region before, which may be
+    // on another tile so only that one value is exchanged
+    //
+    Tensor before = region.begin == 0 ? previous.reshape({}) : values[region.begin - 1];
+    auto v = graph.addVertex(cs, vertexName, {{"values", values.slice(region.begin, region.end)},
+                                              {"previous", before},
+                                              {"count", partials[i]}});
+    graph.setTileMapping(v, region.tile);
+    graph.setTileMapping(partials[i], region.tile);
+    graph.setPerfEstimate(v, 10 + (region.end - region.begin) * 2);
+  }
+  prog.add(Execute(cs));
+
+  return ShardedSum(graph, partials, INT, prog, debugName + "/Sum");
+}
+
+Tensor CountGreater(Graph& graph, const Tensor& a, const Tensor& b,
+                    Sequence& prog, const std::string& debugName) {
+  auto regions = SplitOverWorkers(graph, a);
+  std::string vertexName = poputil::templateVertex("CountGreater", a.elementType());
+
+  ComputeSet cs = graph.addComputeSet(debugName);
+  Tensor partials = graph.addVariable(INT, {regions.size()}, debugName + "/Partials");
+  for (std::size_t i = 0; i < regions.size(); ++i) {
+    const auto& region = regions[i];
+    auto v = graph.addVertex(cs, vertexName, {{"a", a.slice(region.begin, region.end)},
+                                              {"b", b.slice(region.begin, region.end)},
+                                              {"count", partials[i]}});
+    graph.setTileMapping(v, region.tile);
+    graph.setTileMapping(partials[i], region.tile);
+    graph.setPerfEstimate(v, 10 + (region.end - region.begin) * 2);
+  }
+  prog.add(Execute(cs));
+
+  return popops::reduce(graph, partials, INT, {0}, {popops::Operation::ADD}, prog, debugName + "/Sum");
+}
+
+namespace {
+
+//
+// The sums of each worker, as INT, or as {lo, hi} UNSIGNED_INT words when wide
+//
+Tensor SumByOpcodePartials(Graph& graph, const Tensor& records, unsigned numOpcodes, bool wide,
+                           Sequence& prog, const std::string& debugName) {
+  auto regions = SplitOverWorkers(graph, records);
+  std::string vertexName = poputil::templateVertex(wide ? "SumByOpcodeWide" : "SumByOpcode", records.elementType());
+
+  ComputeSet cs = graph.addComputeSet(debugName);
+  Tensor partials = wide ? graph.addVariable(UNSIGNED_INT, {regions.size(), numOpcodes * 2}, debugName + "/Partials")
+                         : graph.addVariable(INT, {regions.size(), numOpcodes}, debugName + "/Partials");
+  for (std::size_t i = 0; i < regions.size(); ++i) {
+    const auto& region = regions[i];
+    auto v = graph.addVertex(cs, vertexName, {{"records", records.slice(region.begin, region.end)},
+                                              {"sums", partials[i]}});
+    graph.setTileMapping(v, region.tile);
+    graph.setTileMapping(partials[i], region.tile);
+    // 64-bit adds are emulated with several 32-bit instructions
+    graph.setPerfEstimate(v, 10 + (region.end - region.begin) * (wide ? 6 : 3));
+  }
+  prog.add(Execute(cs));
+  return partials;
+}
+
+} // namespace
+
+Tensor SumByOpcode(Graph& graph, const Tensor& records, unsigned numOpcodes,
+                   Sequence& prog, const std::string& debugName) {
+  Tensor partials = SumByOpcodePartials(graph, records, numOpcodes, false, prog, debugName);
+  return popops::reduce(graph, partials, INT, {0}, {popops::Operation::ADD}, prog, debugName + "/Sum");
+}
+
+//
+// The partials are gathered onto tile 0 and summed there, by one vertex per total. There
+// are only a few per worker, so this is cheap next to the pass over the records.
+//
+Tensor SumByOpcodeWide(Graph& graph, const Tensor& records, unsigned numOpcodes,
+                       Sequence& prog, const std::string& debugName) {
+  Tensor partials = SumByOpcodePartials(graph, records, numOpcodes, true, prog, debugName);
+
+  ComputeSet cs = graph.addComputeSet(debugName + "/Sum");
+  Tensor sums = graph.addVariable(UNSIGNED_INT, {numOpcodes, 2}, debugName + "/Sums");
+  graph.setTileMapping(sums, 0);
+  for (unsigned op = 0; op < numOpcodes; ++op) {
+    auto v = graph.addVertex(cs, "SumWidePairs", {{"pairs", partials.slice(2 * op, 2 * op + 2, 1).flatten()},
+                                                  {"sum", sums[op]}});
+    graph.setTileMapping(v, 0);
+    graph.setPerfEstimate(v, 10 + partials.dim(0) * 4);
+  }
+  prog.add(Execute(cs));
+  return sums;
+}
+
+Tensor AimedDepthWide(Graph& graph, const Tensor& records, const Tensor& aim,
+                      Sequence& prog, const std::string& debugName) {
+  auto regions = SplitOverWorkers(graph, records);
+  std::string vertexName = poputil::templateVertex("AimedDepthWide", records.elementType());
+
+  ComputeSet cs = graph.addComputeSet(debugName);
+  Tensor partials = graph.addVariable(UNSIGNED_INT, {regions.size(), 2}, debugName + "/Partials");
+  for (std::size_t i = 0; i < regions.size(); ++i) {
+    const auto& region = regions[i];
+    auto v = graph.addVertex(cs, vertexName, {{"records", records.slice(region.begin, region.end)},
+                                              {"aim", aim.slice(region.begin, region.end)},
+                                              {"depth", partials[i]}});
+    graph.setTileMapping(v, region.tile);
+    graph.setTileMapping(partials[i], region.tile);
+    // 64-bit multiplies and adds are emulated with several 32-bit instructions
+    graph.setPerfEstimate(v, 10 + (region.end - region.begin) * 12);
+  }
+  prog.add(Execute(cs));
+
+  ComputeSet sumCs = graph.addComputeSet(debugName + "/Sum");
+  Tensor sum = graph.addVariable(UNSIGNED_INT, {2}, debugName + "/Total");
+  graph.setTileMapping(sum, 0);
+  auto v = graph.addVertex(sumCs, "SumWidePairs", {{"pairs", partials.flatten()}, {"sum", sum}});
+  graph.setTileMapping(v, 0);
+  graph.setPerfEstimate(v, 10 + regions.size() * 4);
+  prog.add(Execute(sumCs));
+  return sum;
+}
+
+void AccumulateWide(Graph& graph, const Tensor& sum, const Tensor& value,
+                    Sequence& prog, const std::string& debugName) {
+  // The vertex goes on the (first) tile of sum
+  auto mapping = graph.getTileMapping(sum);
+  unsigned tile = 0;
+  while (tile + 1 < mapping.size() && mapping[tile].empty()) {
+    ++tile;
+  }
+
+  ComputeSet cs = graph.addComputeSet(debugName);
+  auto v = graph.addVertex(cs, "AccumulateWide", {{"value", value.reshape({})}, {"sum", sum}});
+  graph.setTileMapping(v, tile);
+  graph.setPerfEstimate(v, 20);
+  prog.add(Execute(cs));
+}
+
+Tensor CountBits(Graph& graph, const Tensor& words, unsigned numBits,
+                 Sequence& prog, const std::string& debugName) {
+  auto regions = SplitOverWorkers(graph, words);
+
+  // The vertex instantiated for the width, or the generic one, for the type of the words
+  std::string vertexName = poputil::templateVertex("CountBits", IsSpecialisedWidth(numBits) ? numBits : 0,
+                                                   words.elementType());
+
+  ComputeSet cs = graph.addComputeSet(debugName);
+  Tensor partials = graph.addVariable(UNSIGNED_INT, {regions.size(), numBits}, debugName + "/Partials");
+  for (std::size_t i = 0; i < regions.size(); ++i) {
+    const auto& region = regions[i];
+    auto v = graph.addVertex(cs, vertexName, {{"words", words.slice(region.begin, region.end)},
+                                               {"counts", partials[i]}});
+    graph.setTileMapping(v, region.tile);
+    graph.setTileMapping(partials[i], region.tile);
+    graph.setPerfEstimate(v, 10 + (region.end - region.begin) * numBits * 2);
+  }
+  prog.add(Execute(cs));
+
+  return ShardedSum(graph, partials, UNSIGNED_INT, prog, debugName + "/Sum");
+}
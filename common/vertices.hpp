@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <poplar/Graph.hpp>
+#include <poplar/Program.hpp>
+#include <poplar/Tensor.hpp>
+
+//
+// Graph builders for the custom vertices in common/codelets
+//
+// The inputs can be any of the narrow types of types.hpp, the vertex for the element
+// type of the input is used. The results are always 32 bits (or 64 bits as {lo, hi}).
+//
+
+//
+// Add the custom codelets to the graph, for days that use the builders below
+//
+void AddCommonCodelets(poplar::Graph& graph);
+
+//
+// A contiguous region of a 1-D tensor on one tile, worked on by one vertex
+//
+struct WorkerRegion {
+  unsigned tile;
+  std::size_t begin;
+  std::size_t end;
+};
+
+//
+// Split the elements of a 1-D tensor into contiguous regions on each tile, with up
+// to one region per worker thread
+//
+std::vector<WorkerRegion> SplitOverWorkers(const poplar::Graph& graph, const poplar::Tensor& tensor);
+
+//
+// Count how many values are greater than the value before them, with values[0]
+// compared to the single element tensor previous. The values are counted in place
+// on the tiles they are mapped to, giving a partial count for each worker, then the
+// partial counts are summed on each IPU before the IPUs' totals are combined (see
+// ShardedSum). Returns a scalar INT.
+//
+poplar::Tensor CountIncreases(poplar::Graph& graph, const poplar::Tensor& values, const poplar::Tensor& previous,
+                              poplar::program::Sequence& prog, const std::string& debugName);
+
+//
+// Count how many elements of a are greater than the corresponding element of b, a
+// and b are 1-D and the same size. The work is split by where a is mapped, with the
+// matching elements of b brought to the same tile. Returns a scalar INT.
+//
+poplar::Tensor CountGreater(poplar::Graph& graph, const poplar::Tensor& a, const poplar::Tensor& b,
+                            poplar::program::Sequence& prog, const std::string& debugName);
+
+//
+// Sum the values of packed command records (see PackCommand) for each opcode, in one
+// pass over the records where they are mapped. Returns an INT tensor of {numOpcodes}
+// with the total for each opcode.
+//
+poplar::Tensor SumByOpcode(poplar::Graph& graph, const poplar::Tensor& records, unsigned numOpcodes,
+                           poplar::program::Sequence& prog, const std::string& debugName);
+
+//
+// As SumByOpcode, but each worker sums its records in 64 bits and the partial sums of
+// the workers are added up in 64 bits, so the totals can't overflow. Returns an
+// UNSIGNED_INT tensor of {numOpcodes, 2}, the {lo, hi} words of each total.
+//
+poplar::Tensor SumByOpcodeWide(poplar::Graph& graph, const poplar::Tensor& records, unsigned numOpcodes,
+                               poplar::program::Sequence& prog, const std::string& debugName);
+
+//
+// The sum of value * aim over the forward command records, with aim the aim at each
+// record (mapped like the records), accumulated in 64 bits. Returns an UNSIGNED_INT
+// tensor of {2}, the {lo, hi} words of the sum.
+//
+poplar::Tensor AimedDepthWide(poplar::Graph& graph, const poplar::Tensor& records, const poplar::Tensor& aim,
+                              poplar::program::Sequence& prog, const std::string& debugName);
+
+//
+// Add the scalar INT value to sum, an UNSIGNED_INT tensor of {2} holding the {lo, hi}
+// words of a 64-bit total, in place on the tile of sum
+//
+void AccumulateWide(poplar::Graph& graph, const poplar::Tensor& sum, const poplar::Tensor& value,
+                    poplar::program::Sequence& prog, const std::string& debugName);
+
+//
+// Count the 1s in each of the numBits bit positions of a 1-D tensor of packed
+// UNSIGNED_CHAR, UNSIGNED_SHORT or UNSIGNED_INT words. The counts of the workers are
+// summed on each IPU before being combined, as for CountIncreases. Returns an
+// UNSIGNED_INT tensor of {numBits}, the most significant bit first. Uses the vertex
+// specialised for numBits when there is one (see specialisedWidths in input.hpp).
+//
+poplar::Tensor CountBits(poplar::Graph& graph, const poplar::Tensor& words, unsigned numBits,
+                         poplar::program::Sequence& prog, const std::string& debugName);
@@ -0,0 +1,12 @@
+#include <wide.hpp>
+#include <stdexcept>
+
+bool UseWide(const Options& options) {
+  if (!options.has("wide")) {
+    return false;
+  }
+  if (options.has("serve") || options.has("batch") || options.get("backend") == "host") {
+    throw std::invalid_argument("--wide copies out a 64-bit result, so can't be used with --serve, --batch or the host backend");
+  }
+  return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <options.hpp>
+
+//
+// 64-bit results, --wide.
+//
+// The day 2 answers are products of sums over the whole input, which overflow 32 bits
+// long before the input stops fitting on the device. With --wide the partial sums of
+// the workers are added up in 64 bits on the device (SumByOpcodeWide, AimedDepthWide)
+// rather than reduced in 32 bits, and copied out as {lo, hi} words for the host to
+// take the product in 64 bits.
+//
+// The result is no longer a single INT, so this throws std::invalid_argument for --serve
+// and --batch, and for the host backend, which follows the 32-bit device arithmetic.
+//
+bool UseWide(const Options& options);
+
+//
+// The 64-bit value of {lo, hi} words copied from the device
+//
+inline long long JoinWide(const unsigned* words) {
+  return static_cast<long long>((static_cast<unsigned long long>(words[1]) << 32) | words[0]);
+}
+
+//
+// a * b wrapping at 64 bits, like the device's 32-bit arithmetic wraps at 32
+//
+inline long long MulWide(long long a, long long b) {
+  return static_cast<long long>(static_cast<unsigned long long>(a) * static_cast<unsigned long long>(b));
+}
@@ -3,135 +3,458 @@
 #include <vector>
 #include <cstdlib>
 #include <algorithm>
+#include <climits>
+#include <optional>
 #include <poplar/Engine.hpp>
 #include <poplar/Graph.hpp>
 #include <popops/ElementWise.hpp>
 #include <popops/codelets.hpp>
-#include <popops/Reduce.hpp>
-#include <popops/Cast.hpp>
 
 #include "common.hpp"
+#include "cache.hpp"
+#include "fit.hpp"
+#include "generate.hpp"
+#include "host.hpp"
+#include "input.hpp"
+#include "mapping.hpp"
+#include "phases.hpp"
+#include "pipeline.hpp"
+#include "profile.hpp"
+#include "serve.hpp"
+#include "shard.hpp"
+#include "types.hpp"
+#include "vertices.hpp"
+#include "wide.hpp"
 
 using namespace std;
 using namespace poplar;
 using namespace poplar::program;
 
-int main()
+//
+// The host check of a streamed run, which also reads the measurements a chunk at a
+// time so they are never all held in memory. Each chunk after the first starts with
+// the last measurement of the one before, so the increase into it is counted.
+//
+long long HostCountStreamed(const HostEngine& host, const MappedFile& data, size_t chunkSize)
 {
+  IntegerReader reader(data.contents());
+  vector<int> chunk(chunkSize + 1);
+  size_t n = reader.read(chunk.data(), chunk.size());
+  long long count = 0;
+  while (n > 1) {
+    chunk.resize(n);
+    count += host.countIncreases(chunk);
+    chunk.resize(chunkSize + 1);
+    chunk[0] = chunk[n - 1];
+    n = 1 + reader.read(chunk.data() + 1, chunkSize);
+  }
+  return count;
+}
 
-  // 
-  // First read in the data and put it into to vector of ints
+//
+// Streaming mode, for inputs of any length.
+//
+// Rather than sizing the input tensor to the whole file, a fixed size chunk is
+// streamed onto the IPU on each iteration of a RepeatWhileTrue loop, which carries on
+// while the host streams in a "more" flag saying there is another chunk. The last
+// measurement of each chunk is carried into the next chunk to compare with its first
+// measurement, and a running count is kept on the device in 64 bits, as {lo, hi}
+// words. So the tile memory used, and the compiled program, are the same however long
+// the input is, and the executable is cached for the chunk size alone.
+//
+// The measurements are parsed as they are streamed, so the parse and host-to-device
+// copy are timed as part of the run phase. --check counts them on the host the same
+// way.
+//
+// Used with --stream, or when the whole input won't fit in tile memory (see fit.hpp).
+//
+int RunStreaming(const Options& options, IpuSession& session, const MappedFile& data, size_t numMeasurements,
+                 PhaseTimer& timer)
+{
+  timer.setParameter("mode", "stream");
+  timer.setParameter("accumulate", 64);
+
+  auto& device = session.getDevice();
+  const Target& target = session.getTarget();
+  Graph& graph = session.getGraph();
+
+  timer.start("graph");
+  AddCommonCodelets(graph);
+
+  size_t chunkSize = options.getUnsigned("chunk", target.getNumTiles() * 256);
+  size_t numChunks = (numMeasurements + chunkSize - 1) / chunkSize;
+  cout << "Streaming " << numChunks << " chunks of " << chunkSize << " measurements" << endl;
+
+  //
+  // The chunk of measurements, the last measurement of the previous chunk, the
+  // running count and whether there is another chunk
   //
+  Tensor chunkTensor = graph.addVariable(INT, {chunkSize}, "chunk");
+  MapTensorBalanced(graph, chunkTensor);
 
-  // Read in the data
-  ifstream data("data.txt");
+  Tensor previousTensor = graph.addVariable(INT, {1}, "previous");
+  graph.setTileMapping(previousTensor, 0);
 
-  // Use a while loop together with the getline() function to read the file line by line
-  string line;
-  vector<int> values;
-  while (getline(data, line))
-  {
-    // Output the text from the file
-    values.push_back(atoi(line.c_str()));
-  }
+  Tensor countTensor = graph.addVariable(UNSIGNED_INT, {2}, "count");
+  graph.setTileMapping(countTensor, 0);
 
-  // This vector will hold the result
-  auto result = std::vector<int>(1);
+  Tensor moreTensor = graph.addVariable(UNSIGNED_INT, {}, "more");
+  graph.setTileMapping(moreTensor, 0);
 
   //
-  // Workout the number of elements in the list
+  // Nothing is greater than INT_MIN, the first measurement is compared with it so is
+  // never counted as an increase. It is also used to pad the final chunk.
   //
-  auto numMeasurements = values.size();
-  cout << "Number of measurements = " << numMeasurements << endl;
+  Tensor minTensor = graph.addConstant<int>(INT, {1}, {INT_MIN}, "min");
+  graph.setTileMapping(minTensor, 0);
+
+  Tensor zero = graph.addConstant<unsigned>(UNSIGNED_INT, {2}, {0, 0}, "zero");
+  graph.setTileMapping(zero, 0);
+
+  auto moreStream = graph.addHostToDeviceFIFO("more", UNSIGNED_INT, 1);
+  auto inputStream = graph.addHostToDeviceFIFO("data", INT, chunkSize);
+  auto outputStream = graph.addDeviceToHostFIFO("result", UNSIGNED_INT, 2);
 
   //
-  // Get an IPU Device, Target & Graph
+  // Each iteration reads a chunk, compares each measurement with the one before it,
+  // with the first compared with the carried measurement, and adds the increases to
+  // the count
   //
-  auto device = GetIPUDevice();
-  Target target = device.getTarget();
-  Graph graph(target);
-  popops::addCodelets(graph);
+  Sequence chunkProg;
+  chunkProg.add(Copy(inputStream, chunkTensor));
+
+  Tensor chunkCountTensor = CountIncreases(graph, chunkTensor, previousTensor, chunkProg, "CountIncreases");
+  AccumulateWide(graph, countTensor, chunkCountTensor, chunkProg, "Accumulate");
+
+  chunkProg.add(Copy(chunkTensor.slice(chunkSize - 1, chunkSize, 0), previousTensor));
+
+  auto toplevelProg = Sequence({Copy(minTensor, previousTensor),
+                                Copy(zero, countTensor),
+                                RepeatWhileTrue(Copy(moreStream, moreTensor), moreTensor, chunkProg),
+                                Copy(countTensor, outputStream)});
+
+  // The profiler is declared before the engine so it can read the profile once the
+  // engine has been destroyed and written it
+  Profiler profiler(options);
+  timer.start("compile");
+  Engine engine(CompileOrLoad(graph, {toplevelProg}, "day1_part1_stream", {chunkSize}, profiler.engineOptions()), profiler.engineOptions());
+  timer.start("load");
+  engine.load(device);
+  timer.stop();
 
-  // 
-  // Create a tensor on the IPU to receive the input data and map it evenly over
-  // the tiles. As we have 2000 measuments we will put two measurements on each tile
   //
+  // Tell the device whether there is another chunk, and parse each chunk as the device
+  // asks for it, padding the last one
+  //
+  size_t chunksLeft = 0;
+  engine.connectStreamToCallback("more", [&](void* p) {
+    *static_cast<unsigned*>(p) = chunksLeft > 0;
+  });
+
+  IntegerReader reader(data.contents());
+  engine.connectStreamToCallback("data", [&](void* p) {
+    int* chunk = static_cast<int*>(p);
+    auto n = reader.read(chunk, chunkSize);
+    std::fill(chunk + n, chunk + chunkSize, INT_MIN);
+    --chunksLeft;
+  });
+
+  auto result = std::vector<unsigned>(2);
+  engine.connectStream("result", result.data());
 
-  Tensor inputDataTensor = graph.addVariable(INT, {numMeasurements}, "inputData");
-  for (unsigned i = 0; i < numMeasurements / 2; ++i)
-  {
-    graph.setTileMapping(inputDataTensor[(i * 2)], i);
-    graph.setTileMapping(inputDataTensor[(i * 2) + 1], i);
+  for (unsigned repeat = 0; repeat < timer.getRepeats(); ++repeat) {
+    reader = IntegerReader(data.contents());
+    chunksLeft = numChunks;
+    timer.start("run");
+    engine.run(0);
+    timer.stop();
   }
 
+  long long count = JoinWide(result.data());
+  std::cout << "Num increasing measurements = " << count << endl;
+  timer.report();
+
   //
-  // Create a second tensor which is the same as inputData but offset 
-  // The first element being repeated.
+  // Check the result on the host with --check
   //
-  Tensor inputDataOffsetTensor = concat(inputDataTensor.slice(0, 1, 0), inputDataTensor.slice(0, numMeasurements - 1, 0));
+  if (options.has("check")) {
+    HostEngine host(options);
+    if (!CheckResult(host, count, HostCountStreamed(host, data, chunkSize))) {
+      return 1;
+    }
+  }
 
+  return 0;
+}
+
+//
+// The tile memory BuildPrograms needs, see fit.hpp
+//
+MemoryPlan PlanMemory(const Target& target, size_t numMeasurements, const Type& inputType, const Options& options)
+{
+  MemoryPlan plan(target, "day1_part1");
+  plan.addTensor("inputData", numMeasurements, inputType);
+
+  // The count of each worker
+  plan.addPerTile("algorithm", "CountIncreases/Partials", target.getNumWorkerContexts(), INT);
+
+  if (options.has("generate")) {
+    // The random steps and their running sum
+    plan.addTemporary("generate", "Generate/Steps", numMeasurements, INT);
+    plan.addTemporary("generate", "Generate/Walk", numMeasurements, INT);
+  }
+  return plan;
+}
+
+//
+// Build the programs to copy in, count and copy out numMeasurements measurements of
+// inputType (see types.hpp). Used for the single run and for each size of input when
+// serving.
+//
+vector<Program> BuildPrograms(Graph& graph, size_t numMeasurements, const Type& inputType, const Options& options)
+{
+  bool generate = options.has("generate");
+
+  AddCommonCodelets(graph);
+
+  // 
+  // Create a tensor on the IPU to receive the input data and map it evenly over
+  // the tiles, however many measurements there are. With more than one IPU the
+  // measurements are split into one block per IPU. Its type is the narrowest that
+  // holds the measurements.
   //
-  // Create a zero constant tensor
-  //
-  Tensor zero = graph.addConstant<int>(INT, {1}, {0}, "zero");
-  graph.setTileMapping(zero, 0);
+
+  Tensor inputDataTensor = graph.addVariable(inputType, {numMeasurements}, "inputData");
+  MapSharded(graph, inputDataTensor);
 
   //
   // Create the a poplar program
   Sequence algorithm;
 
   //
-  // Subtract the input from the input offset tensor to calcualte the different
+  // Count the measurements greater than the one before them with our own vertex, in one
+  // pass over the measurements where they are on each tile. The first measurement is
+  // compared with itself so is never counted. Each worker produces a partial count and
+  // then the partial counts are summed.
   //
-  Tensor differenceTensor = popops::sub(graph, inputDataTensor, inputDataOffsetTensor, algorithm, "Subtract");
+  Tensor resultTensor = CountIncreases(graph, inputDataTensor, inputDataTensor.slice(0, 1, 0), algorithm, "CountIncreases");
 
   //
-  // Determine which values are greater than zero
+  // Set up data streams to copy data in and out of graph. Generated input is written
+  // straight into the input tensor instead.
   //
-  Tensor greaterThanZeroTensor = popops::gt(graph, differenceTensor, zero, algorithm, "Greater");
+  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
 
   //
-  // Need to cast to an INT as the reduce does not work with BOOL
+  // Create the programs which copy data onto the IPU, run the algorithm and copy the data off the IPU
   //
-  Tensor greaterThanZeroCastTensor = popops::cast(graph, greaterThanZeroTensor, INT, algorithm, "Cast");
+  vector<Program> programs(NUM_PROGRAMS);
+  if (generate) {
+    Sequence generateProg;
+    GenerateDepths(graph, inputDataTensor, generateProg, "Generate");
+    programs[COPY_IN] = generateProg;
+  } else {
+    auto inputStream = graph.addHostToDeviceFIFO("data", inputType, numMeasurements);
+    programs[COPY_IN] = Copy(inputStream, inputDataTensor);
+  }
+  programs[ALGORITHM] = algorithm;
+  programs[COPY_OUT] = Copy(resultTensor, outputStream);
+
+  //
+  // Or stream a batch of inputs through them with --batch, see pipeline.hpp
+  //
+  if (UseBatch(options)) {
+    return PipelinePrograms(graph, inputDataTensor, programs);
+  }
+
+  return programs;
+}
+
+int Main(int argc, char** argv)
+{
+  Options options(argc, argv);
+  PhaseTimer timer(options, "day1_part1");
+  // The count is accumulated in 32 bits, or 64 when streamed (see RunStreaming)
+  timer.setParameter("accumulate", 32);
 
   //
-  // Count the number of 1's using a reduce
+  // Or keep the device attached and answer jobs with --serve, see serve.hpp
   //
-  Tensor resultTensor = popops::reduce(graph, greaterThanZeroCastTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "Reduction");
+  if (UseServer(options)) {
+    return Serve(options, timer, "day1_part1",
+                 [&](Graph& graph, const vector<size_t>& shape) {
+                   RequireFit(options, PlanMemory(graph.getTarget(), shape[0], TypeFromId(shape[2]), options));
+                   return BuildPrograms(graph, shape[0], TypeFromId(shape[2]), options);
+                 },
+                 [&](EngineCache& engines, string_view input) {
+                   //
+                   // Padded with the smallest measurement, which is never an increase
+                   //
+                   vector<int> values = ParseIntegers(input);
+                   int padding = values.empty() ? 0 : *min_element(values.begin(), values.end());
+                   values.resize(BucketSize(values.size()), padding);
+                   Type inputType = InputType(options, values);
+                   vector<char> inputData = NarrowValues(values, inputType);
+                   return RunJob(engines.get({values.size(), false, TypeId(inputType)}), inputData.data());
+                 });
+  }
 
   //
-  // Set up data streams to copy data in and out of graph
+  // Or pipeline a batch of inputs with --batch, see pipeline.hpp
   //
-  auto inputStream = graph.addHostToDeviceFIFO("data", INT, numMeasurements);
-  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
+  if (UseBatch(options)) {
+    return RunBatch(options, timer, "day1_part1",
+                    [&](Graph& graph, const vector<size_t>& shape) {
+                      RequireFit(options, PlanMemory(graph.getTarget(), shape[0], INT, options));
+                      return BuildPrograms(graph, shape[0], INT, options);
+                    },
+                    [](string_view input) {
+                      vector<int> values = ParseIntegers(input);
+                      return MakeBatchInput({values.size()}, values);
+                    });
+  }
+
+  bool generate = options.has("generate");
+  timer.setParameter("input", generate ? "generated" : "file");
+
+  //
+  // Or compute it on the host with --backend=host
+  //
+  if (UseHostBackend(options)) {
+    timer.start("parse");
+    MappedFile data(options.get("input", "data.txt"));
+    vector<int> values = ParseIntegers(data.contents());
+    cout << "Number of measurements = " << values.size() << endl;
+    timer.setParameter("size", values.size());
+
+    HostEngine host(options);
+    timer.setParameter("backend", "host");
+    timer.setParameter("isa", host.getIsa());
+    timer.setParameter("threads", host.getThreads());
+    int hostResult = TimeRepeats(timer, "run", [&] { return host.countIncreases(values); });
+    std::cout << "Num increasing measurements = " << hostResult << endl;
+    timer.report();
+    return 0;
+  }
+
+  //
+  // Get an IPU Device, Target & Graph for the backend selected by the options. This
+  // comes before the parse, as whether the input fits on its tiles decides how the
+  // input is read.
+  //
+  timer.start("device");
+  IpuSession session(options);
+  auto& device = session.getDevice();
+  const Target& target = session.getTarget();
+  Graph& graph = session.getGraph();
+  timer.setSession(session);
+
+  // 
+  // First read in the data and put it into to vector of ints
+  //
+
+  // Map the input file and count the measurements, unless they are to be generated on
+  // the device with --generate=<number of measurements>
+  timer.start("parse");
+  optional<MappedFile> data;
+  vector<int> values;
+  size_t numMeasurements = size_t(options.getUnsigned("generate", 0));
+  if (!generate) {
+    data.emplace(options.get("input", "data.txt"));
+    numMeasurements = CountLines(data->contents());
+  }
+  cout << "Number of measurements = " << numMeasurements << endl;
+  timer.setParameter("size", numMeasurements);
+
+  if (!generate) {
+    //
+    // Stream inputs that won't fit on the IPU a chunk at a time, with --stream or when
+    // the whole input won't fit in tile memory. This is decided from the count, before
+    // the measurements are parsed, so the plan is for them as INT, the widest type they
+    // are narrowed from. A streamed input is only parsed as each chunk is requested by
+    // the device.
+    //
+    bool stream = options.has("stream");
+    if (!stream && !Fits(options, PlanMemory(target, numMeasurements, INT, options))) {
+      cout << "The measurements won't fit on the device, streaming them instead" << endl;
+      stream = true;
+    }
+    if (stream) {
+      return RunStreaming(options, session, *data, numMeasurements, timer);
+    }
+
+    values = ParseIntegers(data->contents());
+  }
+
+  // This vector will hold the result
+  auto result = std::vector<int>(1);
+
+  //
+  // The narrowest type that holds the measurements, and the measurements converted to
+  // it to copy to the device (see types.hpp)
+  //
+  Type inputType = InputType(options, values);
+  vector<char> inputData = NarrowValues(values, inputType);
+  cout << "Input type = " << inputType << endl;
+  timer.setParameter("type", inputType.toString());
 
   //
-  // Create top level program which copies data onto the IPU, run the algorithm and copies the data of the ipu
+  // Check the graph will fit before spending the time to compile it
   //
-  auto toplevelProg = Sequence({Copy(inputStream, inputDataTensor), algorithm, Copy(resultTensor, outputStream)});
+  if (!CheckFit(options, timer, PlanMemory(target, numMeasurements, inputType, options))) {
+    return 1;
+  }
+
+  timer.start("graph");
+  vector<Program> programs = BuildPrograms(graph, numMeasurements, inputType, options);
 
   // 
-  // Create the engine and run the program
+  // Compile the graph, or load it from the executable cache, then create the engine.
+  // The profiler is declared before the engine so it can read the profile once the
+  // engine has been destroyed and written it.
   //
-  Engine engine(graph, toplevelProg);
+  Profiler profiler(options);
+  timer.start("compile");
+  Engine engine(CompileOrLoad(graph, programs, "day1_part1", {numMeasurements, generate, TypeId(inputType)}, profiler.engineOptions()), profiler.engineOptions());
+  timer.start("load");
   engine.load(device);
+  timer.stop();
 
   // 
   // Connect the streams to the data on the host
   //
-  engine.connectStream("data", values.data());
+  if (!generate) {
+    engine.connectStream("data", inputData.data());
+  } else {
+    ConnectSeed(engine, options);
+  }
   engine.connectStream("result", result.data());
 
   //
-  // Run the program
+  // Run the programs
   //
-  engine.run(0);
+  RunPhases(engine, timer);
 
   //
   // Print the result
   //
   std::cout << "Num increasing measurements = " << result[0] << endl;
+  timer.report();
+
+  //
+  // Check the result on the host with --check
+  //
+  if (options.has("check") && !generate) {
+    HostEngine host(options);
+    if (!CheckResult(host, result[0], host.countIncreases(values))) {
+      return 1;
+    }
+  }
 
   return 0;
 }
+
+int main(int argc, char** argv)
+{
+  return RunMain(argc, argv, Main);
+}
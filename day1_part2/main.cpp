@@ -5,161 +5,301 @@
 #include <algorithm>
 #include <poplar/Engine.hpp>
 #include <poplar/Graph.hpp>
-#include <poplar/IPUModel.hpp>
 #include <popops/ElementWise.hpp>
 #include <popops/codelets.hpp>
-#include <popops/Reduce.hpp>
-#include <popops/Cast.hpp>
 
 #include "common.hpp"
+#include "cache.hpp"
+#include "fit.hpp"
+#include "generate.hpp"
+#include "host.hpp"
+#include "input.hpp"
+#include "mapping.hpp"
+#include "phases.hpp"
+#include "pipeline.hpp"
+#include "profile.hpp"
+#include "serve.hpp"
+#include "types.hpp"
+#include "vertices.hpp"
 
 using namespace std;
 using namespace poplar;
 using namespace poplar::program;
 
-int main()
+//
+// The tile memory BuildPrograms needs, see fit.hpp
+//
+MemoryPlan PlanMemory(const Target& target, size_t numMeasurements, size_t windowSize, const Type& inputType,
+                      const Options& options)
 {
+  MemoryPlan plan(target, "day1_part2");
+  plan.addTensor("inputData", numMeasurements, inputType);
 
-  // 
-  // First read in the data and put it into to vector of ints
   //
+  // The measurements windowSize before those on a tile start on the tiles before, so
+  // they are exchanged into a copy: the first windowSize of them, or all of them when
+  // the window is longer than a tile holds. At least the first worker's region is
+  // copied, as a vertex reads its region from one place. And the count of each worker.
+  //
+  unsigned numWorkers = target.getNumWorkerContexts();
+  size_t perTile = BalancedElementsPerTile(target, numMeasurements, inputType, target.getNumTiles());
+  size_t shifted = std::min(perTile, std::max(windowSize, (perTile + numWorkers - 1) / numWorkers));
+  plan.addPerTile("algorithm", "CountGreater/Shifted", shifted, inputType);
+  plan.addPerTile("algorithm", "CountGreater/Partials", numWorkers, INT);
 
-  // Read in the data
-  ifstream data("data.txt");
-
-  // Use a while loop together with the getline() function to read the file line by line
-  string line;
-  vector<int> values;
-  while (getline(data, line))
-  {
-    // Output the text from the file
-    values.push_back(atoi(line.c_str()));
+  if (options.has("generate")) {
+    // The random steps and their running sum
+    plan.addTemporary("generate", "Generate/Steps", numMeasurements, INT);
+    plan.addTemporary("generate", "Generate/Walk", numMeasurements, INT);
   }
+  return plan;
+}
 
-  // This vector will hold the result
-  auto result = std::vector<int>(1);
+//
+// Build the programs to copy in numMeasurements measurements of inputType (see
+// types.hpp), compare the windows and copy out the count. Used for the single run and
+// for each size of input when serving.
+//
+vector<Program> BuildPrograms(Graph& graph, size_t numMeasurements, size_t windowSize, const Type& inputType,
+                              const Options& options)
+{
+  bool generate = options.has("generate");
+
+  AddCommonCodelets(graph);
 
   //
-  // Workout the number of elements in the list
+  // Create a tensor on the IPU to receive the data and map it evenly over the tiles,
+  // with the narrowest type that holds the measurements
   //
-  auto numMeasurements = values.size();
-  cout << "Number of measurements = " << numMeasurements << endl;
+  Tensor inputDataTensor = graph.addVariable(inputType, {numMeasurements}, "inputData");
+  MapTensorBalanced(graph, inputDataTensor);
+
+  // Create a control program that is a sequence of steps
+  Sequence prog;
 
   //
-  // Get an IPU Device, Target & Graph
-  //
-  auto device = GetIPUDevice();
-  Target target = device.getTarget();
-  Graph graph(target);
-  popops::addCodelets(graph);
+  // Two neighbouring windows share all but one measurement, i.e. for a window of 3
+  //
+  //  A + B + C
+  //      B + C + D
+  //
+  // So the second window is larger exactly when D > A. Rather than summing the windows
+  // we compare each measurement with the one windowSize before it, which works for any
+  // window size. The only copy is of the first worker's region of the measurements
+  // before on each tile, as it starts on the tile before.
+  //
+  Tensor resultTensor;
+  if (windowSize < numMeasurements) {
+    resultTensor = CountGreater(graph,
+                                inputDataTensor.slice(windowSize, numMeasurements, 0),
+                                inputDataTensor.slice(0, numMeasurements - windowSize, 0),
+                                prog, "CountGreater");
+  } else {
+    //
+    // There are no two complete windows to compare
+    //
+    resultTensor = graph.addConstant<int>(INT, {}, {0}, "zero");
+    graph.setTileMapping(resultTensor, 0);
+  }
 
   //
-  // Create tensor on the IPU to receive the data an map it over the tiles.
-  // We will create a tensor fo shape {numMeasurements, 3} so we can sum 3 values 
-  // using a reduction
+  // Set up data streams to copy data in and out of graph. Generated input is written
+  // straight into the input tensor instead.
   //
+  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
 
-  Tensor inputDataTensor = graph.addVariable(INT, {numMeasurements, 3}, "inputData");
-  for (unsigned i = 0; i < 3; ++i) {
-    for (unsigned j = 0; j < numMeasurements / 2; ++j) {
-      graph.setTileMapping(inputDataTensor[(j * 2)][i], j);
-      graph.setTileMapping(inputDataTensor[(j * 2) + 1][i], j);  
-    }
+  //
+  // Create the programs which copy data onto the IPU, run the algorithm and copy the data off the IPU
+  //
+  vector<Program> programs(NUM_PROGRAMS);
+  if (generate) {
+    Sequence generateProg;
+    GenerateDepths(graph, inputDataTensor, generateProg, "Generate");
+    programs[COPY_IN] = generateProg;
+  } else {
+    auto inputStream = graph.addHostToDeviceFIFO("data", inputType, numMeasurements);
+    programs[COPY_IN] = Copy(inputStream, inputDataTensor);
   }
+  programs[ALGORITHM] = prog;
+  programs[COPY_OUT] = Copy(resultTensor, outputStream);
 
-  Tensor zero = graph.addConstant<int>(INT, {1}, {0}, "zero");
-  graph.setTileMapping(zero, 0);
+  //
+  // Or stream a batch of inputs through them with --batch, see pipeline.hpp
+  //
+  if (UseBatch(options)) {
+    return PipelinePrograms(graph, inputDataTensor, programs);
+  }
 
-  // 6. Create constants for the data, the offset data and zeros
-  // Create a control program that is a sequence of steps
-  Sequence prog;
+  return programs;
+}
 
-  // Helper tensor of the first column of the input date tensor
-  Tensor inputDataColOneTensor = inputDataTensor.slice(0, 1, 1).flatten();
+int Main(int argc, char** argv)
+{
+  Options options(argc, argv);
+  PhaseTimer timer(options, "day1_part2");
+  timer.setParameter("accumulate", 32);
 
   //
-  // Copy and rotate the values into the other columns
-  //
-  // We want to end up with a matrix like this
-  // 
-  //  A B C
-  //  B C D 
-  //  C D 0
-  //  D 0 0
-  //
-  prog.add(Copy(concat(inputDataColOneTensor.slice(1, numMeasurements, 0), zero), inputDataTensor.slice(1, 2, 1).flatten()));
-  prog.add(Copy(concat(inputDataColOneTensor.slice(2, numMeasurements, 0), zero.broadcast(2, 0)), inputDataTensor.slice(2, 3, 1).flatten()));
+  // Or keep the device attached and answer jobs with --serve, see serve.hpp
+  //
+  if (UseServer(options)) {
+    size_t windowSize = options.getUnsigned("window", 3);
+    return Serve(options, timer, "day1_part2",
+                 [&](Graph& graph, const vector<size_t>& shape) {
+                   RequireFit(options, PlanMemory(graph.getTarget(), shape[0], shape[1], TypeFromId(shape[3]), options));
+                   return BuildPrograms(graph, shape[0], shape[1], TypeFromId(shape[3]), options);
+                 },
+                 [&](EngineCache& engines, string_view input) {
+                   //
+                   // Padded with the smallest measurement, which is never greater
+                   // than the one windowSize before it
+                   //
+                   vector<int> values = ParseIntegers(input);
+                   int padding = values.empty() ? 0 : *min_element(values.begin(), values.end());
+                   values.resize(BucketSize(values.size()), padding);
+                   Type inputType = InputType(options, values);
+                   vector<char> inputData = NarrowValues(values, inputType);
+                   return RunJob(engines.get({values.size(), windowSize, false, TypeId(inputType)}), inputData.data());
+                 });
+  }
 
   //
-  // Sum the row i.e. reduce in first column
-  //
-  // i.e.
+  // Or pipeline a batch of inputs with --batch, see pipeline.hpp
+  //
+  if (UseBatch(options)) {
+    size_t windowSize = options.getUnsigned("window", 3);
+    return RunBatch(options, timer, "day1_part2",
+                    [&](Graph& graph, const vector<size_t>& shape) {
+                      RequireFit(options, PlanMemory(graph.getTarget(), shape[0], shape[1], INT, options));
+                      return BuildPrograms(graph, shape[0], shape[1], INT, options);
+                    },
+                    [&](string_view input) {
+                      vector<int> values = ParseIntegers(input);
+                      return MakeBatchInput({values.size(), windowSize}, values);
+                    });
+  }
+
   // 
-  //  A B C = A + B + C
-  //  B C D = B + C + D
-  //  C D 0 = C + D
-  //  D 0 0 = D
+  // First read in the data and put it into to vector of ints
   //
-  Tensor inputWindowedDataTensor = popops::reduce(graph, inputDataTensor, INT, {1}, {popops::Operation::ADD}, prog, "Reduction");
 
-  //
-  // Create a second tensor which is the same as inputData but offset 
-  // The first element being repeated.
-  //
-  Tensor inputWindowedDataOffsetTensor = concat(inputWindowedDataTensor.slice(0, 1, 0), inputWindowedDataTensor.slice(0, numMeasurements -1, 0));
+  // Map the input file and parse the measurements in place, unless they are to be
+  // generated on the device with --generate=<number of measurements>
+  timer.start("parse");
+  bool generate = options.has("generate");
+  vector<int> values;
+  if (!generate) {
+    MappedFile data(options.get("input", "data.txt"));
+    values = ParseIntegers(data.contents());
+  }
+
+  // This vector will hold the result
+  auto result = std::vector<int>(1);
 
   //
-  // Subtract the input from the input offset tensor to calcualte the different
+  // Workout the number of elements in the list
   //
-  Tensor differenceTensor = popops::sub(graph, inputWindowedDataTensor, inputWindowedDataOffsetTensor, prog, "Subtract");
+  auto numMeasurements = generate ? size_t(options.getUnsigned("generate", 0)) : values.size();
+  cout << "Number of measurements = " << numMeasurements << endl;
+  timer.setParameter("size", numMeasurements);
+  timer.setParameter("input", generate ? "generated" : "file");
 
   //
-  // Determine which values are greater than zero
+  // The size of the sliding window, 3 in the puzzle
   //
-  Tensor greaterThanZeroTensor = popops::gt(graph, differenceTensor, zero, prog, "Greater");
+  size_t windowSize = options.getUnsigned("window", 3);
+  cout << "Window size = " << windowSize << endl;
 
   //
-  // Need to cast to an INT as the reduce does not work with BOOL
-  //
-  Tensor greaterThanZeroCastTensor = popops::cast(graph, greaterThanZeroTensor, INT, prog, "Cast");
+  // Or compute it on the host with --backend=host
+  //
+  if (UseHostBackend(options)) {
+    HostEngine host(options);
+    timer.setParameter("backend", "host");
+    timer.setParameter("isa", host.getIsa());
+    timer.setParameter("threads", host.getThreads());
+    int hostResult = TimeRepeats(timer, "run", [&] { return host.countWindowIncreases(values, windowSize); });
+    std::cout << "Num increasing measurements = " << hostResult << endl;
+    timer.report();
+    return 0;
+  }
 
   //
-  // Count the number of 1's using a reduce
+  // The narrowest type that holds the measurements, and the measurements converted to
+  // it to copy to the device (see types.hpp)
   //
-  Tensor resultTensor = popops::reduce(graph, greaterThanZeroCastTensor, INT, {0}, {popops::Operation::ADD}, prog, "Reduction");
+  Type inputType = InputType(options, values);
+  vector<char> inputData = NarrowValues(values, inputType);
+  cout << "Input type = " << inputType << endl;
+  timer.setParameter("type", inputType.toString());
 
   //
-  // Set up data streams to copy data in and out of graph
+  // Get an IPU Device, Target & Graph for the backend selected by the options
   //
-  auto inputStream = graph.addHostToDeviceFIFO("data", INT, numMeasurements);
-  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
+  timer.start("device");
+  IpuSession session(options);
+  auto& device = session.getDevice();
+  const Target& target = session.getTarget();
+  Graph& graph = session.getGraph();
+  timer.setSession(session);
 
   //
-  // Create top level program which copies data onto the IPU, run the algorithm and copies the data of the ipu
+  // Check the graph will fit before spending the time to compile it
   //
-  auto toplevelProg = Sequence({Copy(inputStream, inputDataTensor.slice(0, 1, 1).flatten()), prog, Copy(resultTensor, outputStream)});
+  if (!CheckFit(options, timer, PlanMemory(target, numMeasurements, windowSize, inputType, options))) {
+    return 1;
+  }
+
+  timer.start("graph");
+  vector<Program> programs = BuildPrograms(graph, numMeasurements, windowSize, inputType, options);
 
   // 
-  // Create the engine and run the program
-  //
-  Engine engine(graph, toplevelProg);
+  // Compile the graph, or load it from the executable cache, then create the engine.
+  // The profiler is declared before the engine so it can read the profile once the
+  // engine has been destroyed and written it.
+  //
+  Profiler profiler(options);
+  timer.start("compile");
+  Engine engine(CompileOrLoad(graph, programs, "day1_part2", {numMeasurements, windowSize, generate, TypeId(inputType)}, profiler.engineOptions()), profiler.engineOptions());
+  timer.start("load");
   engine.load(device);
+  timer.stop();
 
   // 
   // Connect the streams to the data on the host
   //
-  engine.connectStream("data", values.data());
+  if (!generate) {
+    engine.connectStream("data", inputData.data());
+  } else {
+    ConnectSeed(engine, options);
+  }
   engine.connectStream("result", result.data());
 
   //
-  // Run the program
+  // Run the programs
   //
-  engine.run(0);
+  RunPhases(engine, timer);
 
   //
   // Print the result
   //
   std::cout << "Num increasing measurements = " << result[0] << endl;
+  timer.report();
+
+  //
+  // Check the result on the host with --check
+  //
+  if (options.has("check") && !generate) {
+    HostEngine host(options);
+    if (!CheckResult(host, result[0], host.countWindowIncreases(values, windowSize))) {
+      return 1;
+    }
+  }
 
   return 0;
 }
+
+int main(int argc, char** argv)
+{
+  return RunMain(argc, argv, Main);
+}
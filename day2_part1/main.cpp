@@ -7,139 +7,296 @@
 #include <poplar/Graph.hpp>
 #include <popops/ElementWise.hpp>
 #include <popops/codelets.hpp>
-#include <popops/Reduce.hpp>
-#include <popops/Cast.hpp>
 
 #include "common.hpp"
+#include "cache.hpp"
+#include "fit.hpp"
+#include "generate.hpp"
+#include "host.hpp"
+#include "input.hpp"
+#include "mapping.hpp"
+#include "phases.hpp"
+#include "pipeline.hpp"
+#include "profile.hpp"
+#include "serve.hpp"
+#include "types.hpp"
+#include "vertices.hpp"
+#include "wide.hpp"
 
 using namespace std;
 using namespace poplar;
 using namespace poplar::program;
 
 
-int main()
+//
+// The tile memory BuildPrograms needs, see fit.hpp
+//
+MemoryPlan PlanMemory(const Target& target, size_t numCmds, const Type& inputType, const Options& options)
 {
+  MemoryPlan plan(target, "day2_part1");
+  plan.addTensor("inputCommands", numCmds, inputType);
+
+  // The sums of each worker, {lo, hi} words with --wide
+  plan.addPerTile("algorithm", "SumByOpcode/Partials", target.getNumWorkerContexts() * 3 * (options.has("wide") ? 2 : 1),
+                  options.has("wide") ? UNSIGNED_INT : INT);
+
+  if (options.has("generate")) {
+    // The random opcodes and values, packed into the records
+    plan.addTemporary("generate", "Generate/Opcodes", numCmds, INT);
+    plan.addTemporary("generate", "Generate/Values", numCmds, INT);
+  }
+  return plan;
+}
+
+//
+// Build the programs to copy in, decode and copy out numCmds command records of
+// inputType (see types.hpp). Used for the single run and for each size of input when
+// serving.
+//
+vector<Program> BuildPrograms(Graph& graph, size_t numCmds, const Type& inputType, const Options& options)
+{
+  bool generate = options.has("generate");
+
+  AddCommonCodelets(graph);
 
   // 
-  // First read in the data and put it into to vector of ints
+  // Create a tensor on the IPU to receive the command records and map it evenly over
+  // the tiles. Its type is the narrowest that holds the records, which for the puzzle
+  // input is a byte per record.
   //
 
-  // Read in the data
-  ifstream data("data.txt");
-
-  // Use a while loop together with the getline() function to read the file line by line
-  string line;
-  //vector<unsigned> commands;
-  vector<int> hValues;
-  vector<int> vValues;
-  while (getline(data, line))
-  {
-    // Output the text from the file
-    auto space = line.find(" ");
-    auto command = line.substr(0, space);
-    auto value = line.substr(space + 1, line.size() - space);
-
-    if(command == "forward") {
-      hValues.push_back(atoi(value.c_str()));
-    } else if (command == "up") {
-      vValues.push_back(0 - atoi(value.c_str()));
-    } else if (command == "down") {
-      vValues.push_back(atoi(value.c_str()));
-    }
-  }
-  // This vector will hold the result
-  auto result = std::vector<int>(1);
+  Tensor inputCommandsTensor = graph.addVariable(inputType, {numCmds}, "inputCommands");
+  MapTensorBalanced(graph, inputCommandsTensor);
 
   //
-  // Workout the number of elements in the list
+  // Create the a poplar program
   //
-  auto numHCmds = hValues.size();
-  auto numVCmds = vValues.size();
-  cout << "Number of horizontal commands = " << numHCmds << endl;
-  cout << "Number of depth commands = " << numVCmds << endl;
+  Sequence algorithm;
 
   //
-  // Get an IPU Device, Target & Graph
+  // Decode the records and sum the values for each opcode, i.e. a masked reduction
+  // for each of forward, up and down in a single pass over the records.
+  //
+  // With --wide the sums are added up in 64 bits and copied out as {lo, hi} words for
+  // the host to take the product, see wide.hpp
   //
-  auto device = GetIPUDevice();
-  Target target = device.getTarget();
-  Graph graph(target);
-  popops::addCodelets(graph);
+  Tensor resultTensor;
+  if (UseWide(options)) {
+    resultTensor = SumByOpcodeWide(graph, inputCommandsTensor, 3, algorithm, "SumByOpcode").flatten();
+  } else {
+    Tensor sumsTensor = SumByOpcode(graph, inputCommandsTensor, 3, algorithm, "SumByOpcode");
 
-  // 
-  // Create a tensors on the IPU to receive the input data and map it evenly over
-  // the tiles.
+    //
+    // Multiply the horizontal position (the sum of forward) by the depth (the sum of down
+    // minus the sum of up)
+    //
+    resultTensor = popops::map(graph,
+                               popops::expr::Mul(popops::expr::_1,
+                                 popops::expr::Sub(popops::expr::_2, popops::expr::_3)),
+                               {sumsTensor[FORWARD], sumsTensor[DOWN], sumsTensor[UP]},
+                               algorithm, "Multiplication");
+  }
+
+  //
+  // Set up data streams to copy data in and out of graph. Generated input is written
+  // straight into the input tensor instead.
   //
+  auto outputStream = graph.addDeviceToHostFIFO("result", resultTensor.elementType(), resultTensor.numElements());
+  
+  //
+  // Create the programs which copy data onto the IPU, run the algorithm and copy the data off the IPU
+  //
+  vector<Program> programs(NUM_PROGRAMS);
+  if (generate) {
+    Sequence generateProg;
+    GenerateCommands(graph, inputCommandsTensor, generateProg, "Generate");
+    programs[COPY_IN] = generateProg;
+  } else {
+    auto inputStream = graph.addHostToDeviceFIFO("data", inputType, numCmds);
+    programs[COPY_IN] = Copy(inputStream, inputCommandsTensor);
+  }
+  programs[ALGORITHM] = algorithm;
+  programs[COPY_OUT] = Copy(resultTensor, outputStream);
 
-  Tensor inputHCommandsTensor = graph.addVariable(INT, {numHCmds}, "inputHCommands");
-  for (unsigned i = 0; i < numHCmds ; ++i)
-  {
-    graph.setTileMapping(inputHCommandsTensor[i], i);
+  //
+  // Or stream a batch of inputs through them with --batch, see pipeline.hpp
+  //
+  if (UseBatch(options)) {
+    return PipelinePrograms(graph, inputCommandsTensor, programs);
   }
 
-  Tensor inputVCommandsTensor = graph.addVariable(INT, {numVCmds}, "inputVCommands");
-  for (unsigned i = 0; i < numVCmds ; ++i)
-  {
-    graph.setTileMapping(inputVCommandsTensor[i], i);
+  return programs;
+}
+
+int Main(int argc, char** argv)
+{
+  Options options(argc, argv);
+  PhaseTimer timer(options, "day2_part1");
+  timer.setParameter("accumulate", UseWide(options) ? 64 : 32);
+
+  //
+  // Or keep the device attached and answer jobs with --serve, see serve.hpp
+  //
+  if (UseServer(options)) {
+    return Serve(options, timer, "day2_part1",
+                 [&](Graph& graph, const vector<size_t>& shape) {
+                   RequireFit(options, PlanMemory(graph.getTarget(), shape[0], TypeFromId(shape[3]), options));
+                   return BuildPrograms(graph, shape[0], TypeFromId(shape[3]), options);
+                 },
+                 [&](EngineCache& engines, string_view input) {
+                   //
+                   // Padded with "forward 0" records, which move nothing
+                   //
+                   vector<int> records = ParsePackedCommands(input);
+                   records.resize(BucketSize(records.size()), 0);
+                   Type inputType = InputType(options, records);
+                   vector<char> inputData = NarrowValues(records, inputType);
+                   return RunJob(engines.get({records.size(), false, false, TypeId(inputType)}), inputData.data());
+                 });
   }
 
   //
-  // Create the a poplar program
+  // Or pipeline a batch of inputs with --batch, see pipeline.hpp
   //
-  Sequence algorithm;
+  if (UseBatch(options)) {
+    return RunBatch(options, timer, "day2_part1",
+                    [&](Graph& graph, const vector<size_t>& shape) {
+                      RequireFit(options, PlanMemory(graph.getTarget(), shape[0], INT, options));
+                      return BuildPrograms(graph, shape[0], INT, options);
+                    },
+                    [](string_view input) {
+                      vector<int> records = ParsePackedCommands(input);
+                      return MakeBatchInput({records.size()}, records);
+                    });
+  }
 
+  // 
+  // First read in the data and put it into to vector of ints
   //
-  // Sum the horizontal commands
+
+  // Map the input file and parse each command straight into a packed record of
+  // (value << 2 | opcode), which is what is copied onto the IPU. Unless they are to be
+  // generated on the device with --generate=<number of commands>.
+  timer.start("parse");
+  bool generate = options.has("generate");
+  vector<int> records;
+  if (!generate) {
+    MappedFile data(options.get("input", "data.txt"));
+    records = ParsePackedCommands(data.contents());
+  }
+
+  // This vector will hold the result, or with --wide the {lo, hi} words of the sums
+  // of forward, up and down
+  bool wide = UseWide(options);
+  auto result = std::vector<int>(1);
+  auto wideResult = std::vector<unsigned>(6);
+
   //
-  Tensor resultHTensor = popops::reduce(graph, inputHCommandsTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "ReductionH");
+  // Workout the number of elements in the list
+  //
+  auto numCmds = generate ? size_t(options.getUnsigned("generate", 0)) : records.size();
+  cout << "Number of commands = " << numCmds << endl;
+  timer.setParameter("size", numCmds);
+  timer.setParameter("input", generate ? "generated" : "file");
 
   //
-  // Sum the vertical commands
+  // Or compute it on the host with --backend=host
   //
-  Tensor resultVTensor = popops::reduce(graph, inputVCommandsTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "ReductionV");
+  if (UseHostBackend(options)) {
+    HostEngine host(options);
+    timer.setParameter("backend", "host");
+    timer.setParameter("isa", host.getIsa());
+    timer.setParameter("threads", host.getThreads());
+    int hostResult = TimeRepeats(timer, "run", [&] { return host.dive(records); });
+    std::cout << "Result = " << hostResult << endl;
+    timer.report();
+    return 0;
+  }
 
   //
-  // Multiply the results
+  // The narrowest type that holds the records, and the records converted to it to copy
+  // to the device (see types.hpp)
   //
-  Tensor resultTensor = popops::mul(graph, resultHTensor, resultVTensor, algorithm, "Multiplication");
+  Type inputType = InputType(options, records);
+  vector<char> inputData = NarrowValues(records, inputType);
+  cout << "Input type = " << inputType << endl;
+  timer.setParameter("type", inputType.toString());
 
   //
-  // Set up data streams to copy data in and out of graph
+  // Get an IPU Device, Target & Graph for the backend selected by the options
   //
-  auto inputHStream = graph.addHostToDeviceFIFO("dataH", INT, numHCmds);
-  auto inputVStream = graph.addHostToDeviceFIFO("dataV", INT, numVCmds);
-  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
-  
+  timer.start("device");
+  IpuSession session(options);
+  auto& device = session.getDevice();
+  const Target& target = session.getTarget();
+  Graph& graph = session.getGraph();
+  timer.setSession(session);
+
   //
-  // Create top level program which copies data onto the IPU, run the algorithm and copies the data of the ipu
+  // Check the graph will fit before spending the time to compile it
   //
-  auto toplevelProg = Sequence({Copy(inputHStream, inputHCommandsTensor), 
-                               Copy(inputVStream, inputVCommandsTensor), 
-                               algorithm, 
-                               Copy(resultTensor, outputStream)});
+  if (!CheckFit(options, timer, PlanMemory(target, numCmds, inputType, options))) {
+    return 1;
+  }
+
+  timer.start("graph");
+  vector<Program> programs = BuildPrograms(graph, numCmds, inputType, options);
 
   // 
-  // Create the engine and run the program
+  // Compile the graph, or load it from the executable cache, then create the engine.
+  // The profiler is declared before the engine so it can read the profile once the
+  // engine has been destroyed and written it.
   //
-  Engine engine(graph, toplevelProg);
+  Profiler profiler(options);
+  timer.start("compile");
+  Engine engine(CompileOrLoad(graph, programs, "day2_part1", {numCmds, generate, wide, TypeId(inputType)}, profiler.engineOptions()), profiler.engineOptions());
+  timer.start("load");
   engine.load(device);
+  timer.stop();
 
   // 
   // Connect the streams to the data on the host
   //
-  engine.connectStream("dataH", hValues.data());
-  engine.connectStream("dataV", vValues.data());
-  engine.connectStream("result", result.data());
+  if (!generate) {
+    engine.connectStream("data", inputData.data());
+  } else {
+    ConnectSeed(engine, options);
+  }
+  if (wide) {
+    engine.connectStream("result", wideResult.data());
+  } else {
+    engine.connectStream("result", result.data());
+  }
+
+  //
+  // Run the programs
+  //
+  RunPhases(engine, timer);
 
   //
-  // Run the program
+  // Print the result, with --wide the product of the 64-bit sums
   //
-  engine.run(0);
+  long long answer = result[0];
+  if (wide) {
+    answer = MulWide(JoinWide(&wideResult[2 * FORWARD]), JoinWide(&wideResult[2 * DOWN]) - JoinWide(&wideResult[2 * UP]));
+  }
+  std::cout << "Result = " << answer << endl;
+  timer.report();
 
   //
-  // Print the result
+  // Check the result on the host with --check
   //
-  std::cout << "Result = " << result[0] << endl;
+  if (options.has("check") && !generate) {
+    HostEngine host(options);
+    if (!CheckResult(host, answer, wide ? host.diveWide(records) : host.dive(records))) {
+      return 1;
+    }
+  }
 
   return 0;
 }
+
+int main(int argc, char** argv)
+{
+  return RunMain(argc, argv, Main);
+}
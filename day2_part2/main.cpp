@@ -8,149 +8,335 @@
 #include <popops/ElementWise.hpp>
 #include <popops/codelets.hpp>
 #include <popops/Reduce.hpp>
-#include <popops/Cast.hpp>
 
 #include "common.hpp"
+#include "cache.hpp"
+#include "fit.hpp"
+#include "generate.hpp"
+#include "host.hpp"
+#include "input.hpp"
+#include "mapping.hpp"
+#include "phases.hpp"
+#include "pipeline.hpp"
+#include "profile.hpp"
+#include "serve.hpp"
+#include "scan.hpp"
+#include "types.hpp"
+#include "vertices.hpp"
+#include "wide.hpp"
 
 using namespace std;
 using namespace poplar;
 using namespace poplar::program;
 
 
-int main()
+//
+// The tile memory BuildPrograms needs, see fit.hpp
+//
+MemoryPlan PlanMemory(const Target& target, size_t numCmds, const Type& inputType, const Options& options)
 {
+  MemoryPlan plan(target, "day2_part2");
+  plan.addTensor("inputCommands", numCmds, inputType);
 
-  // 
-  // First read in the data and put it into to vector of ints
-  //
+  // The aim changes and the aim, the depths reuse the memory of the aim changes
+  plan.addTemporary("algorithm", "DecodeAimChange", numCmds, INT);
+  plan.addTemporary("algorithm", "Aim", numCmds, INT);
 
-  // Read in the data
-  ifstream data("data.txt");
-
-  // Use a while loop together with the getline() function to read the file line by line
-  string line;
-  //vector<unsigned> commands;
-  vector<int> hValues;
-  vector<int> aims;
-  vector<int> vValues;
-
-  int aim = 0;
-  while (getline(data, line))
-  {
-    // Output the text from the file
-    auto space = line.find(" ");
-    auto command = line.substr(0, space);
-    auto value = line.substr(space + 1, line.size() - space);
-
-    if(command == "forward") {
-      hValues.push_back(atoi(value.c_str()));
-      aims.push_back(aim);
-    } else if (command == "up") {
-      aim = aim + (0 - atoi(value.c_str()));
-      //vValues.push_back(0 - atoi(value.c_str()));
-    } else if (command == "down") {
-      aim = aim + atoi(value.c_str());
-      //vValues.push_back(atoi(value.c_str()));
-    }
+  // The sums of each worker, {lo, hi} words with --wide
+  plan.addPerTile("algorithm", "SumByOpcode/Partials", target.getNumWorkerContexts() * 3 * (options.has("wide") ? 2 : 1),
+                  options.has("wide") ? UNSIGNED_INT : INT);
+
+  if (options.has("generate")) {
+    // The random opcodes and values, packed into the records
+    plan.addTemporary("generate", "Generate/Opcodes", numCmds, INT);
+    plan.addTemporary("generate", "Generate/Values", numCmds, INT);
   }
-  // This vector will hold the result
-  auto result = std::vector<int>(1);
+  return plan;
+}
 
+//
+// Build the programs to copy in, follow and copy out numCmds command records of
+// inputType (see types.hpp). Used for the single run and for each size of input when
+// serving.
+//
+vector<Program> BuildPrograms(Graph& graph, size_t numCmds, const Type& inputType, const Options& options)
+{
+  bool generate = options.has("generate");
 
+  AddCommonCodelets(graph);
 
+  // 
+  // Create a tensor on the IPU to receive the command records and map it evenly over
+  // the tiles. Its type is the narrowest that holds the records, which for the puzzle
+  // input is a byte per record.
   //
-  // Workout the number of elements in the list
+
+  Tensor inputCommandsTensor = graph.addVariable(inputType, {numCmds}, "inputCommands");
+  MapTensorBalanced(graph, inputCommandsTensor);
+
+  //
+  // Create the a poplar program
   //
-  auto numHCmds = hValues.size();
-  auto numAims = aims.size();
-  cout << "Number of horizontal commands = " << numHCmds << endl;
-  cout << "Number of aim commands = " << numAims << endl;
+  Sequence algorithm;
 
+  //
+  // Expressions to decode a record (or _1 when used in the maps below). The record is
+  // widened to INT first, as the aim and the depths need the full range.
+  //
+  auto record = popops::expr::Cast(popops::expr::_1, INT);
+  auto value = popops::expr::Shr(record, popops::expr::Const(2));
+  auto opcode = popops::expr::BitwiseAnd(record, popops::expr::Const(3));
 
+  //
+  // Decode how much each command changes the aim by: up decreases it, down increases it
+  // and forward leaves it alone
+  //
+  Tensor aimChangeTensor = popops::map(graph,
+                                       popops::expr::Select(
+                                         popops::expr::Neg(value),
+                                         popops::expr::Select(value, popops::expr::Const(0), popops::expr::Equal(opcode, popops::expr::Const(int(DOWN)))),
+                                         popops::expr::Equal(opcode, popops::expr::Const(int(UP)))),
+                                       {inputCommandsTensor}, algorithm, "DecodeAimChange");
 
   //
-  // Get an IPU Device, Target & Graph
+  // The aim at each command is the running total of the changes before it, which we
+  // calculate with a parallel prefix sum over all the tiles
   //
-  auto device = GetIPUDevice();
-  Target target = device.getTarget();
-  Graph graph(target);
-  popops::addCodelets(graph);
+  Tensor aimTensor = PrefixSum(graph, aimChangeTensor, ScanType::Inclusive, algorithm, "Aim");
 
-  // 
-  // Create a tensors on the IPU to receive the input data and map it evenly over
-  // the tiles. Of shape {numHCmds, 2}. The first column is going to be hCommands
-  // The second column is going to be the aim value.
   //
+  // With --wide the forward total and the depth are summed in 64 bits and copied out as
+  // {lo, hi} words for the host to take the product, see wide.hpp
+  //
+  Tensor resultTensor;
+  if (UseWide(options)) {
+    Tensor forwardTensor = SumByOpcodeWide(graph, inputCommandsTensor, 3, algorithm, "SumByOpcode")[FORWARD];
+    Tensor depthSumTensor = AimedDepthWide(graph, inputCommandsTensor, aimTensor, algorithm, "Depth");
+    resultTensor = concat(forwardTensor, depthSumTensor);
+  } else {
+    //
+    // Calculate the depth change for each command, forward value * aim for forward
+    // commands and 0 for the others
+    //
+    Tensor depthTensor = popops::map(graph,
+                                     popops::expr::Select(
+                                       popops::expr::Mul(value, popops::expr::_2),
+                                       popops::expr::Const(0),
+                                       popops::expr::Equal(opcode, popops::expr::Const(int(FORWARD)))),
+                                     {inputCommandsTensor, aimTensor}, algorithm, "Depth");
+
+    //
+    // Sum the forward commands, and the depth changes
+    //
+    Tensor sumsTensor = SumByOpcode(graph, inputCommandsTensor, 3, algorithm, "SumByOpcode");
+    Tensor depthSumTensor = popops::reduce(graph, depthTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "ReductionDepthSum");
 
-  Tensor inputTensor = graph.addVariable(INT, {numHCmds, 2}, "inputTensor");
-  for (unsigned i = 0; i < numHCmds ; ++i)
-  {
-    graph.setTileMapping(inputTensor[i][0], i);
-    graph.setTileMapping(inputTensor[i][1], i);
+    //
+    // Multiply the results
+    //
+    resultTensor = popops::mul(graph, sumsTensor[FORWARD], depthSumTensor, algorithm, "Multiplication");
   }
 
+  //
+  // Set up data streams to copy data in and out of graph. Generated input is written
+  // straight into the input tensor instead.
+  //
+  auto outputStream = graph.addDeviceToHostFIFO("result", resultTensor.elementType(), resultTensor.numElements());
+  
+  //
+  // Create the programs which copy data onto the IPU, run the algorithm and copy the data off the IPU
+  //
+  vector<Program> programs(NUM_PROGRAMS);
+  if (generate) {
+    Sequence generateProg;
+    GenerateCommands(graph, inputCommandsTensor, generateProg, "Generate");
+    programs[COPY_IN] = generateProg;
+  } else {
+    auto inputStream = graph.addHostToDeviceFIFO("data", inputType, numCmds);
+    programs[COPY_IN] = Copy(inputStream, inputCommandsTensor);
+  }
+  programs[ALGORITHM] = algorithm;
+  programs[COPY_OUT] = Copy(resultTensor, outputStream);
 
   //
-  // Create the a poplar program
+  // Or stream a batch of inputs through them with --batch, see pipeline.hpp
   //
-  Sequence algorithm;
+  if (UseBatch(options)) {
+    return PipelinePrograms(graph, inputCommandsTensor, programs);
+  }
+
+  return programs;
+}
+
+int Main(int argc, char** argv)
+{
+  Options options(argc, argv);
+  PhaseTimer timer(options, "day2_part2");
+  timer.setParameter("accumulate", UseWide(options) ? 64 : 32);
 
   //
-  // Sum the horizontal commands
+  // Or keep the device attached and answer jobs with --serve, see serve.hpp
   //
-  Tensor horizontalTensor = popops::reduce(graph, inputTensor.slice(0, 1, 1), INT, {0}, {popops::Operation::ADD}, algorithm, "ReductionH");
+  if (UseServer(options)) {
+    return Serve(options, timer, "day2_part2",
+                 [&](Graph& graph, const vector<size_t>& shape) {
+                   RequireFit(options, PlanMemory(graph.getTarget(), shape[0], TypeFromId(shape[3]), options));
+                   return BuildPrograms(graph, shape[0], TypeFromId(shape[3]), options);
+                 },
+                 [&](EngineCache& engines, string_view input) {
+                   //
+                   // Padded with "forward 0" records, which move nothing
+                   //
+                   vector<int> records = ParsePackedCommands(input);
+                   records.resize(BucketSize(records.size()), 0);
+                   Type inputType = InputType(options, records);
+                   vector<char> inputData = NarrowValues(records, inputType);
+                   return RunJob(engines.get({records.size(), false, false, TypeId(inputType)}), inputData.data());
+                 });
+  }
 
   //
-  // Calculate the depth. 
-  // - First multiple the forward by the aim fo each row
-  // - Then sum the resulting values
+  // Or pipeline a batch of inputs with --batch, see pipeline.hpp
   //
-  Tensor depthTensor = popops::reduce(graph, inputTensor, INT, {1}, {popops::Operation::MUL}, algorithm, "ReductionDepth");
-  Tensor depthSumTensor = popops::reduce(graph, depthTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "ReductionDepthSum");
+  if (UseBatch(options)) {
+    return RunBatch(options, timer, "day2_part2",
+                    [&](Graph& graph, const vector<size_t>& shape) {
+                      RequireFit(options, PlanMemory(graph.getTarget(), shape[0], INT, options));
+                      return BuildPrograms(graph, shape[0], INT, options);
+                    },
+                    [](string_view input) {
+                      vector<int> records = ParsePackedCommands(input);
+                      return MakeBatchInput({records.size()}, records);
+                    });
+  }
 
+  // 
+  // First read in the data and put it into to vector of ints
   //
-  // Multiply the results
+
+  // Map the input file and parse each command straight into a packed record of
+  // (value << 2 | opcode), which is what is copied onto the IPU. Unless they are to be
+  // generated on the device with --generate=<number of commands>.
+  timer.start("parse");
+  bool generate = options.has("generate");
+  vector<int> records;
+  if (!generate) {
+    MappedFile data(options.get("input", "data.txt"));
+    records = ParsePackedCommands(data.contents());
+  }
+
+  // This vector will hold the result, or with --wide the {lo, hi} words of the forward
+  // total and the depth
+  bool wide = UseWide(options);
+  auto result = std::vector<int>(1);
+  auto wideResult = std::vector<unsigned>(4);
+
+  //
+  // Workout the number of elements in the list
   //
-  Tensor resultTensor = popops::mul(graph, horizontalTensor, depthSumTensor, algorithm, "Multiplication");
+  auto numCmds = generate ? size_t(options.getUnsigned("generate", 0)) : records.size();
+  cout << "Number of commands = " << numCmds << endl;
+  timer.setParameter("size", numCmds);
+  timer.setParameter("input", generate ? "generated" : "file");
 
   //
-  // Set up data streams to copy data in and out of graph
+  // Or compute it on the host with --backend=host
   //
-  auto inputHStream = graph.addHostToDeviceFIFO("dataH", INT, numHCmds);
-  auto inputAStream = graph.addHostToDeviceFIFO("dataA", INT, numAims);
-  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
-  
+  if (UseHostBackend(options)) {
+    HostEngine host(options);
+    timer.setParameter("backend", "host");
+    timer.setParameter("isa", host.getIsa());
+    timer.setParameter("threads", host.getThreads());
+    int hostResult = TimeRepeats(timer, "run", [&] { return host.diveWithAim(records); });
+    std::cout << "Result = " << hostResult << endl;
+    timer.report();
+    return 0;
+  }
+
+  //
+  // The narrowest type that holds the records, and the records converted to it to copy
+  // to the device (see types.hpp)
+  //
+  Type inputType = InputType(options, records);
+  vector<char> inputData = NarrowValues(records, inputType);
+  cout << "Input type = " << inputType << endl;
+  timer.setParameter("type", inputType.toString());
+
+  //
+  // Get an IPU Device, Target & Graph for the backend selected by the options
   //
-  // Create top level program which copies data onto the IPU, run the algorithm and copies the data of the ipu
-  // We are going to copy the forward values into the first column and the aim values in the second
+  timer.start("device");
+  IpuSession session(options);
+  auto& device = session.getDevice();
+  const Target& target = session.getTarget();
+  Graph& graph = session.getGraph();
+  timer.setSession(session);
+
   //
-  auto toplevelProg = Sequence({Copy(inputHStream, inputTensor.slice(0, 1, 1).flatten()), 
-                               Copy(inputAStream, inputTensor.slice(1, 2, 1).flatten()),
-                               algorithm,
-                               Copy(resultTensor, outputStream)});
+  // Check the graph will fit before spending the time to compile it
+  //
+  if (!CheckFit(options, timer, PlanMemory(target, numCmds, inputType, options))) {
+    return 1;
+  }
+
+  timer.start("graph");
+  vector<Program> programs = BuildPrograms(graph, numCmds, inputType, options);
 
   // 
-  // Create the engine and run the program
+  // Compile the graph, or load it from the executable cache, then create the engine.
+  // The profiler is declared before the engine so it can read the profile once the
+  // engine has been destroyed and written it.
   //
-  Engine engine(graph, toplevelProg);
+  Profiler profiler(options);
+  timer.start("compile");
+  Engine engine(CompileOrLoad(graph, programs, "day2_part2", {numCmds, generate, wide, TypeId(inputType)}, profiler.engineOptions()), profiler.engineOptions());
+  timer.start("load");
   engine.load(device);
+  timer.stop();
 
   // 
   // Connect the streams to the data on the host
   //
-  engine.connectStream("dataH", hValues.data());
-  engine.connectStream("dataA", aims.data());
-  engine.connectStream("result", result.data());
+  if (!generate) {
+    engine.connectStream("data", inputData.data());
+  } else {
+    ConnectSeed(engine, options);
+  }
+  if (wide) {
+    engine.connectStream("result", wideResult.data());
+  } else {
+    engine.connectStream("result", result.data());
+  }
 
   //
-  // Run the program
+  // Run the programs
   //
-  engine.run(0);
+  RunPhases(engine, timer);
 
   //
-  // Print the result
+  // Print the result, with --wide the product of the 64-bit sums
   //
-  std::cout << "Result = " << result[0] << endl;
+  long long answer = result[0];
+  if (wide) {
+    answer = MulWide(JoinWide(&wideResult[0]), JoinWide(&wideResult[2]));
+  }
+  std::cout << "Result = " << answer << endl;
+  timer.report();
+
+  //
+  // Check the result on the host with --check
+  //
+  if (options.has("check") && !generate) {
+    HostEngine host(options);
+    if (!CheckResult(host, answer, wide ? host.diveWithAimWide(records) : host.diveWithAim(records))) {
+      return 1;
+    }
+  }
 
   return 0;
 }
+
+int main(int argc, char** argv)
+{
+  return RunMain(argc, argv, Main);
+}
@@ -11,93 +11,81 @@
 #include <popops/Cast.hpp>
 
 #include "common.hpp"
+#include "cache.hpp"
+#include "fit.hpp"
+#include "generate.hpp"
+#include "host.hpp"
+#include "input.hpp"
+#include "mapping.hpp"
+#include "phases.hpp"
+#include "pipeline.hpp"
+#include "profile.hpp"
+#include "serve.hpp"
+#include "shard.hpp"
+#include "types.hpp"
+#include "vertices.hpp"
+#include "wide.hpp"
 
 using namespace std;
 using namespace poplar;
 using namespace poplar::program;
 
 
-int main()
+//
+// The tile memory BuildPrograms needs, see fit.hpp
+//
+MemoryPlan PlanMemory(const Target& target, size_t numRows, unsigned numCols, const Type& inputType,
+                      const Options& options)
 {
-
-  // 
-  // First read in the data and put it into to vector of ints
-  //
-
-  // Read in the data
-  ifstream data("data.txt");
-
-  // Use a while loop together with the getline() function to read the file line by line
-  // And write to a matrix of row x columns
-  string line;
-  std::vector<std::vector<int>> values;
-  while (getline(data, line))
-  {
-    std::vector<int> r;
-    for(char c : line) {
-      r.push_back(c == '0' ? 0 : 1);
-    }
-    values.push_back(r);
-  }
-
-  // This vector will hold the result
-  auto result = std::vector<int>(1);
-
-  //
-  // Workout the size of the matrix
-  //
-  auto numRows = values.size();
-  auto numCols = values[0].size(); 
-
-  //
-  // Create a flatten list of values so we can write the data onto the IPU
-  //
-  std::vector<int> flattenValues;
-  for(int i = 0; i < values.size(); ++i) {
-    for(int j = 0; j < values[i].size(); ++j) {
-      flattenValues.push_back(values[i][j]);
-    }
+  MemoryPlan plan(target, "day3_part1");
+  plan.addTensor("inputTensor", numRows, inputType);
+
+  // The counts of each worker
+  plan.addPerTile("algorithm", "CountBits/Partials", target.getNumWorkerContexts() * numCols, UNSIGNED_INT);
+
+  if (options.has("generate")) {
+    // The random 16 bit halves of each word, as ints and as unsigned ints
+    plan.addTemporary("generate", "Generate/High", numRows, INT);
+    plan.addTemporary("generate", "Generate/Low", numRows, INT);
+    plan.addTemporary("generate", "Generate/CastHigh", numRows, UNSIGNED_INT);
+    plan.addTemporary("generate", "Generate/CastLow", numRows, UNSIGNED_INT);
   }
+  return plan;
+}
 
+//
+// Build the programs to copy in numRows rows of numCols bits packed into inputType (see
+// types.hpp), find the result and copy it out. Used for the single run and for each
+// shape of input when serving.
+//
+vector<Program> BuildPrograms(Graph& graph, size_t numRows, unsigned numCols, const Type& inputType,
+                              const Options& options)
+{
+  bool generate = options.has("generate");
 
-  //
-  // Get an IPU Device, Target & Graph
-  //
-  auto device = GetIPUDevice();
-  Target target = device.getTarget();
-  Graph graph(target);
-  popops::addCodelets(graph);
+  AddCommonCodelets(graph);
 
   // 
-  // Create a tensors on the IPU to receive the input data and map it evenly over
-  // the tiles.
+  // Create a tensor on the IPU to receive the packed rows and map it evenly over
+  // the tiles, split into a block per IPU if there is more than one. The rows are
+  // packed into the narrowest unsigned type with numCols bits.
   //
 
-  Tensor inputTensor = graph.addVariable(INT, {numRows, numCols}, "inputTensor");
-  
-  for (unsigned i = 0; i < numRows ; ++i) {
-    for (unsigned j = 0; j < numCols ; ++j) {
-      graph.setTileMapping(inputTensor[i][j], i);
-    }
-  }
+  Tensor inputTensor = graph.addVariable(inputType, {numRows}, "inputTensor");
+  MapSharded(graph, inputTensor);
 
   //
-  // Create some constants we will use later, 1, 0 and a list of powers of two
+  // Create a list of powers of two, for the bits of a row from the most significant.
+  // And the mask of all the bits in a row.
   //
-  Tensor oneTensor = graph.addConstant<int>(INT, {1}, {1}, "one");
-  graph.setTileMapping(oneTensor, 0);
-
-  Tensor zero = graph.addConstant<int>(INT, {1}, {0}, "zero");
-  graph.setTileMapping(zero, 0);
-
-  Tensor powersOfTwoTensor = graph.addConstant<int>(INT, {12}, {2048, 1024, 512, 256, 128, 64, 32, 16, 8, 4, 2, 1}, "powersOfTwo");
+  vector<unsigned> powersOfTwo(numCols);
+  for (unsigned i = 0; i < numCols; ++i) {
+    powersOfTwo[i] = 1U << (numCols - 1 - i);
+  }
+  Tensor powersOfTwoTensor = graph.addConstant<unsigned>(UNSIGNED_INT, {numCols}, powersOfTwo, "powersOfTwo");
   graph.setTileMapping(powersOfTwoTensor, 0);
 
-  //
-  // Reshape the powers of two tensor to be the same as the number of columns
-  //
-  Tensor powersOfTwoTruncate = powersOfTwoTensor.slice(powersOfTwoTensor.numElements() - numCols, powersOfTwoTensor.numElements(), 0);
-
+  unsigned allBits = numCols == 32 ? ~0U : (1U << numCols) - 1;
 
   //
   // Create the a poplar program
@@ -105,124 +93,268 @@ int main()
   Sequence algorithm;
 
   //
-  // First we are going to convert the input matrix so we have -1 instead of 0. This will enable me to reduce
-  // the colum values and work out if there are more 1' or 0's. i.e the result will be > 0 if more 1 or < 0 if
-  // more 0's
-  // 
-  // Turn
-  // { 
-  //   {0, 1, 0}
-  //   {1, 1, 0}
-  //   {1, 0, 1}
-  // }
-  //
-  // Into
-  // { 
-  //   {-1,  1, -1}
-  //   { 1,  1, -1}
-  //   { 1, -1,  1}
-  // }
-
-
-  Tensor negInputTensor = popops::sub(graph, inputTensor, oneTensor, algorithm, "Subtract");
-  Tensor posNegTensor = popops::add(graph, inputTensor, negInputTensor, algorithm, "Add");
-
-  //
-  // Then reduce all the columns to get a positive or negative value
+  // Count the number of 1's in each column. Each worker goes through its rows with
+  // shifts and masks to count the 1's at each bit, then the counts from each worker
+  // are summed.
   //
   // Turn
   // { 
-  //   {-1,  1, -1}
-  //   { 1,  1, -1}
-  //   { 1, -1,  1}
+  //   0b00100
+  //   0b11110
+  //   0b10110
   // }
   //
   // Into 
   // {
-  //   { 1,  1, -1}
+  //   { 2,  1,  3,  2,  0}
   // }
-  Tensor totalTensor = popops::reduce(graph, posNegTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "ColumnReduction");
+  Tensor countsTensor = CountBits(graph, inputTensor, numCols, algorithm, "CountBits");
 
   //
-  // Convert the totals into which are greater or less than 0. Need to cast
-  // the output to INT as the following operations don't work on BOOL
+  // There are more 1's than 0's in a column when the 1's are more than half of the rows.
+  // Which gives the bitmap for gamma, and multiply it by the powers of two and sum to
+  // get gamma.
   //
   // Turn
-  // { 
-  //   { 1,  1, -1}
+  // {
+  //   { 2,  1,  3,  2,  0}
   // }
   //
   // Into 
   // {
-  //   { 1,  1,  0}
-  // }  
-  Tensor bitTensor = popops::gt(graph, totalTensor, zero, algorithm, "GreaterThan0");
-  Tensor bitCastTensor = popops::cast(graph, bitTensor, INT, algorithm, "GreaterThan0Cast");
-
-  // 
-  // Now we have a bit map, we can multiple it by powers of two to get the values for each power and then number them 
-  // to get the total. First we do gamma. And will use PrintTensor to output the value.
+  //   { 1,  0,  1,  1,  0}
+  // }
   //
-  Tensor gammaPartsTensor = popops::mul(graph, bitCastTensor, powersOfTwoTruncate, algorithm, "CalculateGammaPart");
-  Tensor gammaTensor = popops::reduce(graph, gammaPartsTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "CalculateGamma");
+  Tensor gammaPartsTensor = popops::map(graph,
+                                        popops::expr::Select(
+                                          popops::expr::_2,
+                                          popops::expr::Const(0U),
+                                          popops::expr::Gt(popops::expr::Mul(popops::expr::_1, popops::expr::Const(2U)),
+                                                           popops::expr::Const(unsigned(numRows)))),
+                                        {countsTensor, powersOfTwoTensor}, algorithm, "CalculateGammaPart");
+  Tensor gammaTensor = popops::reduce(graph, gammaPartsTensor, UNSIGNED_INT, {0}, {popops::Operation::ADD}, algorithm, "CalculateGamma");
   algorithm.add(PrintTensor("gamma is = ", gammaTensor));  
 
   // 
-  // For epsilon we do the same, but we first need to invert the bitmap. To invert the bitmap we will subtract 1 and
-  // then square the value
-  //
-  // Turn              { 1, 1, 0}
-  // Into (subtract 1) { 0, 0, -1}
-  // Then (square)     { 0, 0, 1}
-  //
-  // Note: Using the popops::map function to compute the inverted bitmap in 1 api
-  Tensor invertTensor = popops::map(graph, 
-                                    popops::expr::Square(
-                                      popops::expr::Sub(popops::expr::_1, popops::expr::_2)), 
-                                    {bitCastTensor, oneTensor}, algorithm, "InvertBitmap");
-  Tensor epsilonPartsTensor = popops::mul(graph, invertTensor, powersOfTwoTruncate, algorithm, "CalculateEpsilonParts");
-  Tensor epsilon = popops::reduce(graph, epsilonPartsTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "CalculateEpsilon");
+  // Epsilon has the inverted bitmap, so is all the bits not in gamma
+  //
+  Tensor epsilon = popops::map(graph, popops::expr::Sub(popops::expr::Const(allBits), popops::expr::_1),
+                               {gammaTensor}, algorithm, "CalculateEpsilon");
   algorithm.add(PrintTensor("epsilon is = ", epsilon));  
 
   // 
-  // Finally multiple epsilon and gamma together.
+  // Finally gamma and epsilon are copied out for the host to multiply together, as
+  // with rows wider than 16 bits the product needs more than 32 bits.
   //
-  Tensor resultTensor = popops::mul(graph, gammaTensor, epsilon,  algorithm, "Multiply");
+  Tensor resultTensor = concat(gammaTensor.reshape({1}), epsilon.reshape({1}));
 
   //
-  // Set up data streams to copy data in and out of graph
+  // Set up data streams to copy data in and out of graph. Generated input is written
+  // straight into the input tensor instead.
   //
-  auto inputStream = graph.addHostToDeviceFIFO("data", INT, numRows * numCols);
-  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
+  auto outputStream = graph.addDeviceToHostFIFO("result", UNSIGNED_INT, 2);
   
   //
-  // Create top level program which copies data onto the IPU, run the algorithm and copies the data of the ipu
+  // Create the programs which copy data onto the IPU, run the algorithm and copy the data off the IPU
+  //
+  vector<Program> programs(NUM_PROGRAMS);
+  if (generate) {
+    Sequence generateProg;
+    GenerateBits(graph, inputTensor, numCols, generateProg, "Generate");
+    programs[COPY_IN] = generateProg;
+  } else {
+    auto inputStream = graph.addHostToDeviceFIFO("data", inputType, numRows);
+    programs[COPY_IN] = Copy(inputStream, inputTensor);
+  }
+  programs[ALGORITHM] = algorithm;
+  programs[COPY_OUT] = Copy(resultTensor, outputStream);
+
+  //
+  // Or stream a batch of inputs through them with --batch, see pipeline.hpp
+  //
+  if (UseBatch(options)) {
+    return PipelinePrograms(graph, inputTensor, programs);
+  }
+
+  return programs;
+}
+
+int Main(int argc, char** argv)
+{
+  Options options(argc, argv);
+  PhaseTimer timer(options, "day3_part1");
+  timer.setParameter("accumulate", 32);
+
+  //
+  // Or keep the device attached and answer jobs with --serve, see serve.hpp
+  //
+  if (UseServer(options)) {
+    return Serve(options, timer, "day3_part1",
+                 [&](Graph& graph, const vector<size_t>& shape) {
+                   RequireFit(options, PlanMemory(graph.getTarget(), shape[0], shape[1], TypeFromId(shape[3]), options));
+                   return BuildPrograms(graph, shape[0], shape[1], TypeFromId(shape[3]), options);
+                 },
+                 [&](EngineCache& engines, string_view input) {
+                   //
+                   // Padded with pairs of rows of all 0's and all 1's. Each pair adds
+                   // a 1 to every column for every two rows, so the most common bits
+                   // stay the same. The bucket is made one larger if needed to take
+                   // whole pairs.
+                   //
+                   PackedBits packed = ParsePackedBits(input);
+                   size_t numRows = BucketSize(packed.numRows);
+                   numRows += (numRows - packed.numRows) % 2;
+                   unsigned allBits = packed.numCols == 32 ? ~0U : (1U << packed.numCols) - 1;
+                   for (size_t row = packed.numRows; row < numRows; ++row) {
+                     packed.words.push_back((row - packed.numRows) % 2 ? allBits : 0);
+                   }
+                   packed.numRows = numRows;
+                   Type inputType = RowType(options, packed.numCols);
+                   vector<char> inputData = NarrowValues(packed.words, inputType);
+                   unsigned factors[2];
+                   RunJob(engines.get({packed.numRows, packed.numCols, false, TypeId(inputType)}), inputData.data(), factors);
+                   return MulWide(factors[0], factors[1]);
+                 });
+  }
+
   //
-  auto toplevelProg = Sequence({Copy(inputStream, inputTensor.flatten()), 
-                               algorithm,
-                               Copy(resultTensor, outputStream)});
+  // Or pipeline a batch of inputs with --batch, see pipeline.hpp
+  //
+  if (UseBatch(options)) {
+    return RunBatch(options, timer, "day3_part1",
+                    [&](Graph& graph, const vector<size_t>& shape) {
+                      RequireFit(options, PlanMemory(graph.getTarget(), shape[0], shape[1], UNSIGNED_INT, options));
+                      return BuildPrograms(graph, shape[0], shape[1], UNSIGNED_INT, options);
+                    },
+                    [](string_view input) {
+                      PackedBits packed = ParsePackedBits(input);
+                      return MakeBatchInput({packed.numRows, packed.numCols}, packed.words);
+                    },
+                    [](const void* p) {
+                      const unsigned* factors = static_cast<const unsigned*>(p);
+                      return MulWide(factors[0], factors[1]);
+                    });
+  }
 
   // 
-  // Create the engine and run the program
+  // First read in the data and put it into to vector of ints
+  //
+
+  // Map the input file and parse each row straight into a packed word, with the first
+  // character as the most significant bit. This is what is written onto the IPU.
+  // Unless they are to be generated on the device with --generate=<number of rows>
+  // and --bits=<bits per row>.
+  timer.start("parse");
+  bool generate = options.has("generate");
+  PackedBits packed;
+  if (!generate) {
+    MappedFile data(options.get("input", "data.txt"));
+    packed = ParsePackedBits(data.contents());
+  }
+
+  // This vector will hold gamma and epsilon
+  auto result = std::vector<unsigned>(2);
+
+  //
+  // Workout the size of the matrix
+  //
+  auto numRows = generate ? size_t(options.getUnsigned("generate", 0)) : packed.numRows;
+  auto numCols = generate ? options.getUnsigned("bits", 12) : packed.numCols;
+  timer.setParameter("size", numRows);
+  timer.setParameter("input", generate ? "generated" : "file");
+  timer.setParameter("bits", numCols);
+
+  //
+  // Or compute it on the host with --backend=host
+  //
+  if (UseHostBackend(options)) {
+    HostEngine host(options);
+    timer.setParameter("backend", "host");
+    timer.setParameter("isa", host.getIsa());
+    timer.setParameter("threads", host.getThreads());
+    long long hostResult = TimeRepeats(timer, "run", [&] { return host.powerConsumption(packed); });
+    std::cout << "Result = " << hostResult << endl;
+    timer.report();
+    return 0;
+  }
+
+  //
+  // The narrowest type with the bits of a row, and the rows converted to it to copy to
+  // the device (see types.hpp)
+  //
+  Type inputType = RowType(options, numCols);
+  vector<char> inputData = NarrowValues(packed.words, inputType);
+  cout << "Input type = " << inputType << endl;
+  timer.setParameter("type", inputType.toString());
+
+  //
+  // Get an IPU Device, Target & Graph for the backend selected by the options
   //
-  Engine engine(graph, toplevelProg);
+  timer.start("device");
+  IpuSession session(options);
+  auto& device = session.getDevice();
+  const Target& target = session.getTarget();
+  Graph& graph = session.getGraph();
+  timer.setSession(session);
+
+  //
+  // Check the graph will fit before spending the time to compile it
+  //
+  if (!CheckFit(options, timer, PlanMemory(target, numRows, numCols, inputType, options))) {
+    return 1;
+  }
+
+  timer.start("graph");
+  vector<Program> programs = BuildPrograms(graph, numRows, numCols, inputType, options);
+
+  // 
+  // Compile the graph, or load it from the executable cache, then create the engine.
+  // The profiler is declared before the engine so it can read the profile once the
+  // engine has been destroyed and written it.
+  //
+  Profiler profiler(options);
+  timer.start("compile");
+  Engine engine(CompileOrLoad(graph, programs, "day3_part1", {numRows, numCols, generate, TypeId(inputType)}, profiler.engineOptions()), profiler.engineOptions());
+  timer.start("load");
   engine.load(device);
+  timer.stop();
 
   // 
   // Connect the streams to the data on the host
   //
-  engine.connectStream("data", flattenValues.data());
+  if (!generate) {
+    engine.connectStream("data", inputData.data());
+  } else {
+    ConnectSeed(engine, options);
+  }
   engine.connectStream("result", result.data());
 
   //
-  // Run the program
+  // Run the programs
   //
-  engine.run(0);
+  RunPhases(engine, timer);
   
   //
-  // Print the result
+  // Print the result, the product of gamma and epsilon in 64 bits
   //
-  std::cout << "Result = " << result[0] << endl;
-  
+  long long answer = MulWide(result[0], result[1]);
+  std::cout << "Result = " << answer << endl;
+  timer.report();
+
+  //
+  // Check the result on the host with --check
+  //
+  if (options.has("check") && !generate) {
+    HostEngine host(options);
+    if (!CheckResult(host, answer, host.powerConsumption(packed))) {
+      return 1;
+    }
+  }
+
   return 0;
 }
+
+int main(int argc, char** argv)
+{
+  return RunMain(argc, argv, Main);
+}
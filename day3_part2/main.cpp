@@ -10,363 +10,486 @@
 #include <popops/codelets.hpp>
 #include <popops/Reduce.hpp>
 #include <popops/Cast.hpp>
-#include <popops/TopK.hpp>
 #include <popops/DynamicSlice.hpp>
+#include <popops/Sort.hpp>
 
 #include "common.hpp"
+#include "cache.hpp"
+#include "fit.hpp"
+#include "generate.hpp"
+#include "host.hpp"
+#include "input.hpp"
+#include "mapping.hpp"
+#include "phases.hpp"
+#include "pipeline.hpp"
+#include "profile.hpp"
+#include "serve.hpp"
+#include "vertices.hpp"
+#include "wide.hpp"
 
 using namespace std;
 using namespace poplar;
 using namespace poplar::program;
 
 
-Tensor invert(Graph& graph, Tensor a, Sequence& prog) {
-  Tensor oneTensor = graph.addConstant<int>(INT, {1}, {1}, "one");
-  graph.setTileMapping(oneTensor, 0);
+//
+// The two ratings are found at the same time, each on its own half of the tiles.
+//
+enum Rating { OXYGEN_GENERATOR = 0, CO2_SCRUBBER = 1, NUM_RATINGS = 2 };
 
-  Tensor i = popops::sub(graph, a, oneTensor, prog, "");
-  Tensor result = popops::abs(graph, i, prog, "");
-  return result;
+//
+// Create a tensor with one element per rating, each on the first tile of that
+// rating's virtual graph.
+//
+Tensor AddPerRating(Graph& graph, vector<Graph>& ratingGraphs, const string& name)
+{
+  Tensor t = graph.addVariable(UNSIGNED_INT, {NUM_RATINGS}, name);
+  for (unsigned rating = 0; rating < NUM_RATINGS; ++rating) {
+    ratingGraphs[rating].setTileMapping(t[rating], 0);
+  }
+  return t;
 }
 
-int main()
+Tensor AddPerRatingConstant(Graph& graph, vector<Graph>& ratingGraphs,
+                            const vector<unsigned>& values, const string& name)
 {
+  Tensor t = graph.addConstant<unsigned>(UNSIGNED_INT, {NUM_RATINGS}, values, name);
+  for (unsigned rating = 0; rating < NUM_RATINGS; ++rating) {
+    ratingGraphs[rating].setTileMapping(t[rating], 0);
+  }
+  return t;
+}
+
+//
+// Find both ratings by choosing the bits one at a time, from the most significant.
+// sorted has a sorted copy of the rows for each rating, {NUM_RATINGS, numRows}.
+//
+// The rows have been sorted, so the rows that start with the bits chosen so far (the
+// prefix) are a contiguous range [lo, hi) of the sorted rows. And within that range the
+// rows with a 0 in the next bit all come before the rows with a 1. So a binary search
+// for the first row with a 1 splits the range into the 0's and the 1's, which gives the
+// counts to choose the next bit, and the range for the chosen bit is one of the two
+// halves.
+//
+// Each bit takes log2(numRows) steps on single values rather than a pass over all the
+// rows, so apart from sorting the rows once the work does not grow with the number of
+// rows times the number of bits. Once all the bits have been chosen the prefix is the
+// rating.
+//
+// Every value in the search has an element per rating, on that rating's tiles, so each
+// operation below is a single compute set that advances both searches at once. The
+// ratings only differ in the rule for choosing a bit, which is selected per element.
+//
+Tensor FindRatings(Graph& graph, vector<Graph>& ratingGraphs, const Tensor& sorted,
+                   unsigned numCols, Sequence& prog, const string& name)
+{
+  unsigned numRows = sorted.dim(1);
+
+  auto addPerRating = [&](const string& valueName) {
+    return AddPerRating(graph, ratingGraphs, name + "/" + valueName);
+  };
+  auto addConstant = [&](unsigned value) {
+    return AddPerRatingConstant(graph, ratingGraphs, {value, value}, name + "/Constant");
+  };
+
+  Tensor prefix = addPerRating("Prefix");
+  Tensor shift = addPerRating("Shift");
+  Tensor lo = addPerRating("Lo");
+  Tensor hi = addPerRating("Hi");
+  Tensor threshold = addPerRating("Threshold");
+  Tensor left = addPerRating("Left");
+  Tensor right = addPerRating("Right");
+
+  // Where each rating's rows start in the flattened rows, and which rule each uses
+  Tensor rowBase = AddPerRatingConstant(graph, ratingGraphs, {0, numRows}, name + "/RowBase");
+  Tensor mostCommon = AddPerRatingConstant(graph, ratingGraphs, {1, 0}, name + "/MostCommon");
+
+  //
+  // Start with no bits chosen and all the rows, at the most significant bit
+  //
+  prog.add(Copy(addConstant(0), prefix));
+  prog.add(Copy(addConstant(numCols - 1), shift));
+  prog.add(Copy(addConstant(0), lo));
+  prog.add(Copy(addConstant(numRows), hi));
 
-  // 
-  // First read in the data and put it into to vector of ints
   //
+  // The loop sequence for each bit
+  //
+  Sequence step;
 
-  // Read in the data
-  ifstream data("data.txt");
+  //
+  // The first row with a 1 in this bit is the first row >= (prefix * 2 + 1) << shift
+  //
+  popops::mapInPlace(graph,
+                     popops::expr::Shl(popops::expr::Add(popops::expr::Mul(popops::expr::_2, popops::expr::Const(2U)),
+                                                         popops::expr::Const(1U)),
+                                       popops::expr::_3),
+                     {threshold, prefix, shift}, step, name + "/Threshold");
 
-  // Use a while loop together with the getline() function to read the file line by line
-  // And write to a matrix of row x columns
-  string line;
-  std::vector<std::vector<int>> values;
-  while (getline(data, line))
-  {
-    std::vector<int> r;
-    for(char c : line) {
-      r.push_back(c == '0' ? 0 : 1);
-    }
-    values.push_back(r);
+  //
+  // Binary search the range for it. Search [left, right), each step halves it until
+  // left == right, after which the steps make no more changes.
+  //
+  step.add(Copy(lo, left));
+  step.add(Copy(hi, right));
+
+  Sequence search;
+  Tensor mid = popops::map(graph,
+                           popops::expr::Min(popops::expr::Shr(popops::expr::Add(popops::expr::_1, popops::expr::_2),
+                                                               popops::expr::Const(1U)),
+                                             popops::expr::Const(numRows - 1)),
+                           {left, right}, search, name + "/Mid");
+  Tensor active = popops::lt(graph, left, right, search, name + "/Active");
+
+  // Read each rating's middle row from its own copy of the rows
+  Tensor offsets = popops::add(graph, mid, rowBase, search, name + "/Offsets");
+  Tensor midRow = popops::multiSlice(graph, sorted.reshape({NUM_RATINGS * numRows, 1}),
+                                     offsets.reshape({NUM_RATINGS, 1}), {0}, {1}, search,
+                                     popops::SlicePlan(), OptionFlags(), name + "/MidRow")
+                    .reshape({NUM_RATINGS});
+
+  // left = mid + 1 if the middle row is below the threshold
+  popops::mapInPlace(graph,
+                     popops::expr::Select(popops::expr::Add(popops::expr::_2, popops::expr::Const(1U)), popops::expr::_1,
+                                          popops::expr::And(popops::expr::_3, popops::expr::Lt(popops::expr::_4, popops::expr::_5))),
+                     {left, mid, active, midRow, threshold}, search, name + "/MoveLeft");
+
+  // right = mid if the middle row is at or above the threshold
+  popops::mapInPlace(graph,
+                     popops::expr::Select(popops::expr::_2, popops::expr::_1,
+                                          popops::expr::And(popops::expr::_3, popops::expr::Gte(popops::expr::_4, popops::expr::_5))),
+                     {right, mid, active, midRow, threshold}, search, name + "/MoveRight");
+
+  unsigned searchSteps = 1;
+  while ((1UL << searchSteps) <= numRows) {
+    ++searchSteps;
   }
+  step.add(Repeat(searchSteps, search, name + "/Search"));
 
-  // This vector will hold the result
-  auto result = std::vector<int>(1);
+  //
+  // Now [lo, left) are the rows with a 0 and [left, hi) the rows with a 1. Choose the
+  // bit to keep, with _1 the number of matching rows and _2 the number of 1's.
+  //
+  // For the oxygen generator rating keep the most common bit, or 1 if they are equal.
+  // That is 1 when ones * 2 >= matches.
+  //
+  // For the CO2 scrubber rating keep the least common bit, or 0 if they are equal.
+  // That is 1 when ones * 2 < matches. But when all the rows have the same bit, keep
+  // it, so we always stay on a row that exists (including when there is only one left).
+  //
+  Tensor matches = popops::sub(graph, hi, lo, step, name + "/Matches");
+  Tensor ones = popops::sub(graph, hi, left, step, name + "/Ones");
+
+  auto twiceOnes = popops::expr::Mul(popops::expr::_2, popops::expr::Const(2U));
+  auto keepMostCommon = popops::expr::Select(popops::expr::Const(1U), popops::expr::Const(0U),
+                                             popops::expr::Gte(twiceOnes, popops::expr::_1));
+  auto keepLeastCommon = popops::expr::Select(popops::expr::Const(0U),
+                                              popops::expr::Select(popops::expr::Const(1U),
+                                                                   popops::expr::Select(popops::expr::Const(1U), popops::expr::Const(0U),
+                                                                                        popops::expr::Lt(twiceOnes, popops::expr::_1)),
+                                                                   popops::expr::Equal(popops::expr::_2, popops::expr::_1)),
+                                              popops::expr::Equal(popops::expr::_2, popops::expr::Const(0U)));
+  Tensor keep = popops::map(graph,
+                            popops::expr::Select(keepMostCommon, keepLeastCommon, popops::expr::Cast(popops::expr::_3, BOOL)),
+                            {matches, ones, mostCommon}, step, name + "/ChooseBit");
 
   //
-  // Workout the size of the matrix
+  // Narrow the range to the rows with the chosen bit, and add it to the prefix
   //
-  auto numRows = values.size();
-  auto numCols = values[0].size(); 
+  //   lo     = keep ? left : lo
+  //   hi     = keep ? hi : left
+  //   prefix = prefix * 2 + keep
+  //
+  popops::mapInPlace(graph, popops::expr::Select(popops::expr::_2, popops::expr::_1, popops::expr::Cast(popops::expr::_3, BOOL)),
+                     {lo, left, keep}, step, name + "/NarrowLo");
+  popops::mapInPlace(graph, popops::expr::Select(popops::expr::_1, popops::expr::_2, popops::expr::Cast(popops::expr::_3, BOOL)),
+                     {hi, left, keep}, step, name + "/NarrowHi");
+  popops::mapInPlace(graph, popops::expr::Add(popops::expr::Mul(popops::expr::_1, popops::expr::Const(2U)), popops::expr::_2),
+                     {prefix, keep}, step, name + "/AddBit");
 
-  cout << "NumRow = " << numRows << " NumCols = " << numCols << endl;
+  //
+  // Move on to the next bit
+  //
+  popops::subInPlace(graph, shift, addConstant(1), step, name + "/NextBit");
 
   //
-  // Create a flatten list of values so we can write the data onto the IPU
+  // For each column
   //
-  std::vector<int> flattenValues;
-  for(int i = 0; i < values.size(); ++i) {
-    for(int j = 0; j < values[i].size(); ++j) {
-      flattenValues.push_back(values[i][j]);
-    }
+  prog.add(Repeat(numCols, step, name + "/Repeat"));
+
+  return prefix;
+}
+
+//
+// The tile memory BuildPrograms needs, see fit.hpp. Each rating's copy of the rows is
+// on its own half of the tiles.
+//
+MemoryPlan PlanMemory(const Target& target, size_t numRows, const Options& options)
+{
+  unsigned ratingTiles = target.getNumTiles() / NUM_RATINGS;
+  MemoryPlan plan(target, "day3_part2");
+  plan.addTensor("rowsTensor", numRows, UNSIGNED_INT, ratingTiles);
+
+  // The sort exchanges the rows through a temporary copy
+  plan.addTemporary("algorithm", "SortRows", numRows, UNSIGNED_INT, ratingTiles);
+
+  if (options.has("generate")) {
+    // The random 16 bit halves of each word, as ints and as unsigned ints
+    plan.addTemporary("generate", "Generate/High", numRows, INT, ratingTiles);
+    plan.addTemporary("generate", "Generate/Low", numRows, INT, ratingTiles);
+    plan.addTemporary("generate", "Generate/CastHigh", numRows, UNSIGNED_INT, ratingTiles);
+    plan.addTemporary("generate", "Generate/CastLow", numRows, UNSIGNED_INT, ratingTiles);
   }
+  return plan;
+}
+
+//
+// Build the programs to copy in numRows rows of numCols bits, find the result and copy
+// it out. Used for the single run and for each shape of input when serving.
+//
+vector<Program> BuildPrograms(Graph& graph, size_t numRows, unsigned numCols, const Options& options)
+{
+  bool generate = options.has("generate");
 
+  AddCommonCodelets(graph);
 
   //
-  // Get an IPU Device, Target & Graph
+  // Split the tiles in two, one half for each rating. With more than one IPU each
+  // rating gets its own IPUs.
   //
-  auto device = GetIPUDevice();
-  Target target = device.getTarget();
-  Graph graph(target);
-  popops::addCodelets(graph);
+  unsigned numTiles = graph.getTarget().getNumTiles();
+  vector<Graph> ratingGraphs;
+  for (unsigned rating = 0; rating < NUM_RATINGS; ++rating) {
+    ratingGraphs.push_back(graph.createVirtualGraph(rating * numTiles / NUM_RATINGS,
+                                                    (rating + 1) * numTiles / NUM_RATINGS));
+  }
 
   // 
-  // Create a tensors on the IPU to receive the input data and map it evenly over
-  // the tiles.
+  // Create a tensor on the IPU to receive the packed rows, with a copy of the rows for
+  // each rating mapped evenly over that rating's tiles.
   //
 
-  Tensor inputTensor = graph.addVariable(INT, {numRows, numCols}, "inputTensor");
-  Tensor mask = graph.addVariable(INT, {numRows, numCols}, "mask");
-  
-  for (unsigned i = 0; i < numRows ; ++i) {
-    for (unsigned j = 0; j < numCols ; ++j) {
-      graph.setTileMapping(inputTensor[i][j], i);
-      graph.setTileMapping(mask[i][j], i);
-    }
+  Tensor rowsTensor = graph.addVariable(UNSIGNED_INT, {NUM_RATINGS, numRows}, "rowsTensor");
+  for (unsigned rating = 0; rating < NUM_RATINGS; ++rating) {
+    MapTensorBalanced(ratingGraphs[rating], rowsTensor[rating]);
   }
+  Tensor inputTensor = rowsTensor[OXYGEN_GENERATOR];
 
   //
-  // Create a counter variable that will be used to slice the input columns
+  // Create the a poplar program
   //
-  Tensor counter = graph.addVariable(UNSIGNED_INT, {1}, "counter");
-  graph.setTileMapping(counter, 0);
+  Sequence algorithm;
 
   //
-  // Create a counter that will accumulate the number of 0's which are for rows
-  // that we have filtered out.
+  // Give the CO2 scrubber search its own copy of the rows, then sort both copies. The
+  // rows are sorted along dimension 1, so each copy is sorted on its own tiles at the
+  // same time.
   //
-  Tensor num0Counter = graph.addVariable(INT, {1}, "num0Counter");
-  graph.setTileMapping(num0Counter, 0);
+  algorithm.add(Copy(inputTensor, rowsTensor[CO2_SCRUBBER]));
+  popops::sortInPlace(graph, rowsTensor, 1, algorithm, "SortRows");
 
   //
-  // Create some constants we will use later, 1, 0 and a list of powers of two
+  // Calculate the Oxygen Generator Rating and CO2 scrubber rating together
   //
-  Tensor oneTensor = graph.addConstant<int>(INT, {1}, {1}, "one");
-  graph.setTileMapping(oneTensor, 0);
- 
-  Tensor oneTensorU = graph.addConstant<unsigned>(UNSIGNED_INT, {1}, {1}, "one");
-  graph.setTileMapping(oneTensorU, 0);
+  Tensor ratingsTensor = FindRatings(graph, ratingGraphs, rowsTensor, numCols, algorithm, "Ratings");
+  Tensor ogrTensor = ratingsTensor.slice(OXYGEN_GENERATOR, OXYGEN_GENERATOR + 1);
+  Tensor co2SrTensor = ratingsTensor.slice(CO2_SCRUBBER, CO2_SCRUBBER + 1);
+  algorithm.add(PrintTensor("Oxygen Generator Rating is = ", ogrTensor));  
+  algorithm.add(PrintTensor("CO2 Scrubber Rating is = ", co2SrTensor));  
 
-  Tensor trueTensorC = graph.addConstant<bool>(BOOL, {1}, {true}, "true");
-  graph.setTileMapping(trueTensorC, 0);  
+  // 
+  // Finally the two ratings are copied out for the host to multiply together, as
+  // with rows wider than 16 bits the product needs more than 32 bits.
+  //
 
-  Tensor falseTensorC = graph.addConstant<bool>(BOOL, {1}, {false}, "false");
-  graph.setTileMapping(falseTensorC, 0);  
+  //
+  // Set up data streams to copy data in and out of graph. Generated input is written
+  // straight into the input tensor instead.
+  //
+  auto outputStream = graph.addDeviceToHostFIFO("result", UNSIGNED_INT, NUM_RATINGS);
+  
+  //
+  // Create the programs which copy data onto the IPU, run the algorithm and copy the data off the IPU
+  //
+  vector<Program> programs(NUM_PROGRAMS);
+  if (generate) {
+    Sequence generateProg;
+    GenerateBits(graph, inputTensor, numCols, generateProg, "Generate");
+    programs[COPY_IN] = generateProg;
+  } else {
+    auto inputStream = graph.addHostToDeviceFIFO("data", UNSIGNED_INT, numRows);
+    programs[COPY_IN] = Copy(inputStream, inputTensor);
+  }
+  programs[ALGORITHM] = algorithm;
+  programs[COPY_OUT] = Copy(ratingsTensor, outputStream);
 
-  Tensor loopPredicate = graph.addVariable(BOOL, {1}, "loopPredicate");
-  graph.setTileMapping(loopPredicate, 0);
+  //
+  // Or stream a batch of inputs through them with --batch, see pipeline.hpp
+  //
+  if (UseBatch(options)) {
+    return PipelinePrograms(graph, inputTensor, programs);
+  }
 
-  Tensor zero = graph.addConstant<int>(INT, {1}, {0}, "zero");
-  graph.setTileMapping(zero, 0);
+  return programs;
+}
 
-  Tensor zeroU = graph.addConstant<unsigned>(UNSIGNED_INT, {1}, {0U}, "zero");
-  graph.setTileMapping(zeroU, 0U);
+int Main(int argc, char** argv)
+{
+  Options options(argc, argv);
+  PhaseTimer timer(options, "day3_part2");
+  timer.setParameter("accumulate", 32);
 
-  Tensor powersOfTwoTensor = graph.addConstant<int>(INT, {12}, {2048, 1024, 512, 256, 128, 64, 32, 16, 8, 4, 2, 1}, "powersOfTwo");
-  graph.setTileMapping(powersOfTwoTensor, 0);
-  
   //
-  // Reshape the powers of two tensor to be the same as the number of columns
+  // Or keep the device attached and answer jobs with --serve, see serve.hpp
   //
-  Tensor powersOfTwoTruncate = powersOfTwoTensor.slice(powersOfTwoTensor.numElements() - numCols, powersOfTwoTensor.numElements(), 0);
+  if (UseServer(options)) {
+    return Serve(options, timer, "day3_part2",
+                 [&](Graph& graph, const vector<size_t>& shape) {
+                   RequireFit(options, PlanMemory(graph.getTarget(), shape[0], options));
+                   return BuildPrograms(graph, shape[0], shape[1], options);
+                 },
+                 [](EngineCache& engines, string_view input) {
+                   //
+                   // Not padded, as any extra rows could change the ratings
+                   //
+                   PackedBits packed = ParsePackedBits(input);
+                   unsigned ratings[NUM_RATINGS];
+                   RunJob(engines.get({packed.numRows, packed.numCols, false}), packed.words.data(), ratings);
+                   return MulWide(ratings[OXYGEN_GENERATOR], ratings[CO2_SCRUBBER]);
+                 });
+  }
 
   //
-  // Create the a poplar program
+  // Or pipeline a batch of inputs with --batch, see pipeline.hpp
   //
-  Sequence algorithm;
+  if (UseBatch(options)) {
+    return RunBatch(options, timer, "day3_part2",
+                    [&](Graph& graph, const vector<size_t>& shape) {
+                      RequireFit(options, PlanMemory(graph.getTarget(), shape[0], options));
+                      return BuildPrograms(graph, shape[0], shape[1], options);
+                    },
+                    [](string_view input) {
+                      PackedBits packed = ParsePackedBits(input);
+                      return MakeBatchInput({packed.numRows, packed.numCols}, packed.words);
+                    },
+                    [](const void* p) {
+                      const unsigned* ratings = static_cast<const unsigned*>(p);
+                      return MulWide(ratings[OXYGEN_GENERATOR], ratings[CO2_SCRUBBER]);
+                    });
+  }
 
+  // 
+  // First read in the data and put it into to vector of ints
+  //
 
-  // Calculate the Oxygen Generator Rating
-  Tensor ogrTensor;
-  
-  {
-    // 
-    // Copy the input as we are going to apply inplace operations on it
-    //
-    Tensor inputCopyTensor = graph.clone(inputTensor);
-    algorithm.add(Copy(inputTensor, inputCopyTensor));
-    
-    //
-    // Initialize the tensors
-    //
-    algorithm.add(Copy(trueTensorC, loopPredicate));
-    algorithm.add(Copy(zeroU, counter));
-    algorithm.add(Copy(zero, num0Counter));
-    
-    //
-    // The loop sequence
-    //
-    Sequence loop;
-   
-    //
-    // Get the column
-    //
-    Tensor columnTensor = popops::dynamicSlice(graph, inputCopyTensor, counter, {1}, {1}, loop, "ExtractColumn");
-    
-    // Determine the number of 1's
-    Tensor num1sInColumnTensor = popops::reduce(graph, columnTensor, INT, {0}, {popops::Operation::ADD}, loop, "Count1s");
-        
-    // Determine the number of 0's
-    // We will count the number of 0's by subtracting 1, summing and then taking the abs value.
-    Tensor colMinusOne = popops::sub(graph, columnTensor, oneTensor, loop);
-    Tensor num0sNegative = popops::reduce(graph, colMinusOne, INT, {0}, {popops::Operation::ADD}, loop, "");
-    Tensor num0sTotal= popops::abs(graph, num0sNegative, loop, "");
-
-    // Then we will subtract the running count of the number of filtered out rows.
-    Tensor num0sInColumnTensor = popops::sub(graph, num0sTotal, num0Counter , loop, "Count0's");
-
-    // Determine the number of readings in this loop
-    Tensor numReadings = popops::add(graph, num1sInColumnTensor, num0sInColumnTensor, loop, "NumReadings");
-
-    // Calculate the predicate for the mask
-    Tensor more1sPredicate = popops::gteq(graph, num1sInColumnTensor, num0sInColumnTensor, loop, "Predicate").reshape({});
-
-    // Sequences for the if/else below
-    Sequence oneBody;
-    Sequence zeroBody;
-
-    // Mask if more 1's
-    popops::addInPlace(graph, num0Counter, num0sInColumnTensor, oneBody);
-    oneBody.add(Copy(columnTensor.broadcast(numCols, 1), mask));
-
-    // Mask if more 0's
-    Tensor maskInvert = invert(graph, columnTensor.broadcast(numCols, 1), zeroBody);
-    popops::addInPlace(graph, num0Counter, num1sInColumnTensor, zeroBody);
-    zeroBody.add(Copy(maskInvert, mask));
-
-    // If statement
-    loop.add(If(more1sPredicate, oneBody, zeroBody, "IfMore1s"));
-    
-    // Need to reshape to make scalar
-    Tensor moreThan1Reading = popops::gt(graph, numReadings, oneTensor, loop, "Predicate").reshape({});
-    loop.add(Copy(moreThan1Reading, loopPredicate));
-    
-    // Increase the counter
-    popops::addInPlace(graph, counter, oneTensorU, loop);
-    
-    // Apply the mask
-    popops::mulInPlace(graph, inputCopyTensor, mask, loop);
-    
-    //
-    // For each column 
-    // 
-    algorithm.add(RepeatWhileTrue(Sequence(), loopPredicate.reshape({}), loop, "Repeat"));
-    
-    // 
-    // Reduce the rows to be left with the resulting row
-    //
-    Tensor finalBitmap = popops::reduce(graph, inputCopyTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "ColumnReduction");
-    algorithm.add(PrintTensor("Oxygen Generator Rating (Bitmap) =", finalBitmap));
-
-    Tensor ogrTensorParts = popops::mul(graph, finalBitmap, powersOfTwoTruncate, algorithm, "CalculateOGRatePart");
-    ogrTensor = popops::reduce(graph, ogrTensorParts, INT, {0}, {popops::Operation::ADD}, algorithm, "CalculateOGRate");
-    algorithm.add(PrintTensor("Oxygen Generator Rating is = ", ogrTensor));  
-    
-  }
-  
-  // Calculate the CO2 scrubber rating
-  Tensor co2SrTensor;
-  {
-    // 
-    // Copy the input as we are going to apply inplace operations on it
-    //
-    Tensor inputCopyTensor = graph.clone(inputTensor);
-    algorithm.add(Copy(inputTensor, inputCopyTensor));
-    
-    //
-    // Initialize the Tensors
-    //
-    algorithm.add(Copy(trueTensorC, loopPredicate));
-    algorithm.add(Copy(zeroU, counter));
-    algorithm.add(Copy(zero, num0Counter));
-
-    Sequence loop;
-   
-    // Get the column
-    Tensor columnTensor = popops::dynamicSlice(graph, inputCopyTensor, counter, {1}, {1}, loop, "");
-    
-    // Determine the number of 1's
-    Tensor num1sInColumnTensor = popops::reduce(graph, columnTensor, INT, {0}, {popops::Operation::ADD}, loop, "");
-        
-    // Determine the number of 0's
-    Tensor colMinusOne = popops::sub(graph, columnTensor, oneTensor, loop);
-    Tensor num0s = popops::reduce(graph, colMinusOne, INT, {0}, {popops::Operation::ADD}, loop, "");
-    Tensor num0sTotal= popops::abs(graph, num0s, loop, "");
-    Tensor num0sInColumnTensor = popops::sub(graph, num0sTotal, num0Counter , loop, "");
-
-    Tensor numReadings = popops::add(graph, num1sInColumnTensor, num0sInColumnTensor, loop);
-
-    // This is diffent we we need to stop when there is only 1 reading left
-    Tensor moreReadings = popops::gt(graph, numReadings, oneTensor, loop).reshape({});
-
-    Sequence applyMask;
-
-    // Calculate the predicate for the mask
-    Tensor more1sPredicate = popops::gteq(graph, num1sInColumnTensor, num0sInColumnTensor, applyMask, "Predicate").reshape({});
-
-    Sequence oneBody;
-    Sequence zeroBody;
-
-    // Mask if more 1's
-    Tensor maskInvert = invert(graph, columnTensor.broadcast(numCols, 1), oneBody);
-    popops::addInPlace(graph, num0Counter, num1sInColumnTensor, oneBody);
-    oneBody.add(Copy(maskInvert, mask));
-
-    // Mask if more 0's
-    popops::addInPlace(graph, num0Counter, num0sInColumnTensor, zeroBody);
-    zeroBody.add(Copy(columnTensor.broadcast(numCols, 1), mask));
-
-    // If statement
-    applyMask.add(If(more1sPredicate, oneBody, zeroBody, "Loop"));
-    
-    // Need to reshape to make scalar
-    Tensor moreReadingsPredicate = popops::gt(graph, numReadings, oneTensor, applyMask, "Predicate").reshape({});
-    applyMask.add(Copy(moreReadingsPredicate, loopPredicate));
-    
-    // Increase the counter
-    popops::addInPlace(graph, counter, oneTensorU, applyMask);
-    
-    // Apply the mask
-    popops::mulInPlace(graph, inputCopyTensor, mask, applyMask);
-
-    //
-    // If we have 1 element left then we make sure to set the loop predicate to false
-    //
-    Sequence breakSequence;
-    breakSequence.add(Copy(falseTensorC, loopPredicate));
-    
-    // Confitionally exit the loop if we only have 1 reading left
-    loop.add(If(moreReadings, applyMask, breakSequence ,"ApplyMask"));
-
-    //
-    // For each column 
-    // 
-    algorithm.add(RepeatWhileTrue(Sequence(), loopPredicate.reshape({}), loop, "Repeat"));
- 
-    // 
-    // Reduce the rows to be left with the resulting row
-    //
-    Tensor finalBitmap = popops::reduce(graph, inputCopyTensor, INT, {0}, {popops::Operation::ADD}, algorithm, "ColumnReduction");
-    algorithm.add(PrintTensor("CO2 Scrubber Rating (Bitmap) =", finalBitmap));
-
-    Tensor co2SrTensorParts = popops::mul(graph, finalBitmap, powersOfTwoTruncate, algorithm, "CalculateCO2SRart");
-    co2SrTensor = popops::reduce(graph, co2SrTensorParts, INT, {0}, {popops::Operation::ADD}, algorithm, "CalculateCO2SR");
-    algorithm.add(PrintTensor("CO2 Scrubber Rating is = ", co2SrTensor));  
+  // Map the input file and parse each row straight into a packed word, with the first
+  // character as the most significant bit. This is what is written onto the IPU.
+  // Unless they are to be generated on the device with --generate=<number of rows>
+  // and --bits=<bits per row>.
+  timer.start("parse");
+  bool generate = options.has("generate");
+  PackedBits packed;
+  if (!generate) {
+    MappedFile data(options.get("input", "data.txt"));
+    packed = ParsePackedBits(data.contents());
   }
 
-  // 
-  // Finally multiple epsilon and gamma together.
+  // This vector will hold the two ratings
+  auto result = std::vector<unsigned>(NUM_RATINGS);
+
   //
-  Tensor resultTensor = popops::mul(graph, ogrTensor, co2SrTensor,  algorithm, "Multiply");
-  algorithm.add(PrintTensor("Result is = ", resultTensor));  
+  // Workout the size of the matrix
+  //
+  auto numRows = generate ? size_t(options.getUnsigned("generate", 0)) : packed.numRows;
+  auto numCols = generate ? options.getUnsigned("bits", 12) : packed.numCols;
+
+  cout << "NumRow = " << numRows << " NumCols = " << numCols << endl;
+  timer.setParameter("size", numRows);
+  timer.setParameter("input", generate ? "generated" : "file");
+  timer.setParameter("bits", numCols);
 
   //
-  // Set up data streams to copy data in and out of graph
+  // Or compute it on the host with --backend=host
   //
-  auto inputStream = graph.addHostToDeviceFIFO("data", INT, numRows * numCols);
-  auto outputStream = graph.addDeviceToHostFIFO("result", INT, 1);
-  
+  if (UseHostBackend(options)) {
+    HostEngine host(options);
+    timer.setParameter("backend", "host");
+    timer.setParameter("isa", host.getIsa());
+    timer.setParameter("threads", host.getThreads());
+    long long hostResult = TimeRepeats(timer, "run", [&] { return host.lifeSupportRating(packed); });
+    std::cout << "Result = " << hostResult << endl;
+    timer.report();
+    return 0;
+  }
+
   //
-  // Create top level program which copies data onto the IPU, run the algorithm and copies the data of the ipu
+  // Get an IPU Device, Target & Graph for the backend selected by the options
   //
-  auto toplevelProg = Sequence({Copy(inputStream, inputTensor.flatten()), 
-                               algorithm,
-                               Copy(resultTensor, outputStream)});
+  timer.start("device");
+  IpuSession session(options);
+  auto& device = session.getDevice();
+  const Target& target = session.getTarget();
+  Graph& graph = session.getGraph();
+  timer.setSession(session);
+
+  //
+  // Check the graph will fit before spending the time to compile it
+  //
+  if (!CheckFit(options, timer, PlanMemory(target, numRows, options))) {
+    return 1;
+  }
+
+  timer.start("graph");
+  vector<Program> programs = BuildPrograms(graph, numRows, numCols, options);
 
   // 
-  // Create the engine and run the program
+  // Compile the graph, or load it from the executable cache, then create the engine.
+  // The profiler is declared before the engine so it can read the profile once the
+  // engine has been destroyed and written it.
   //
-  Engine engine(graph, toplevelProg);
+  Profiler profiler(options);
+  timer.start("compile");
+  Engine engine(CompileOrLoad(graph, programs, "day3_part2", {numRows, numCols, generate}, profiler.engineOptions()), profiler.engineOptions());
+  timer.start("load");
   engine.load(device);
+  timer.stop();
 
   // 
   // Connect the streams to the data on the host
   //
-  engine.connectStream("data", flattenValues.data());
+  if (!generate) {
+    engine.connectStream("data", packed.words.data());
+  } else {
+    ConnectSeed(engine, options);
+  }
   engine.connectStream("result", result.data());
 
   //
-  // Run the program
+  // Run the programs
   //
-  engine.run(0);
+  RunPhases(engine, timer);
   
   //
-  // Print the result
+  // Print the result, the product of the two ratings in 64 bits
   //
-  std::cout << "Result = " << result[0] << endl;
-  
+  long long answer = MulWide(result[OXYGEN_GENERATOR], result[CO2_SCRUBBER]);
+  std::cout << "Result = " << answer << endl;
+  timer.report();
+
+  //
+  // Check the result on the host with --check
+  //
+  if (options.has("check") && !generate) {
+    HostEngine host(options);
+    if (!CheckResult(host, answer, host.lifeSupportRating(packed))) {
+      return 1;
+    }
+  }
+
   return 0;
 }
 
+int main(int argc, char** argv)
+{
+  return RunMain(argc, argv, Main);
+}